@@ -32,9 +32,9 @@ class HashMix final {
     constexpr std::size_t kMul =
         static_cast<std::size_t>(0xdc3eb94af8ab4c93ULL);
     hash_ *= kMul;
-    hash_ =
-        ((hash << 19) | (hash >> (std::numeric_limits<size_t>::digits - 19))) +
-        hash;
+    hash_ = ((hash_ << 19) |
+             (hash_ >> (std::numeric_limits<size_t>::digits - 19))) +
+            hash;
   }
 
   size_t get() const { return hash_; }
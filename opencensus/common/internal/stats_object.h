@@ -21,6 +21,7 @@
 #include <cstdint>
 #include <iostream>
 #include <limits>
+#include <numeric>
 #include <string>
 #include <vector>
 
@@ -136,6 +137,15 @@ class StatsObject {
   // The returned array slice has num_stats() elements.
   absl::Span<double> MutableCurrentBucket(absl::Time now);
 
+  // Inserts 'count' stats, zero in every bucket, before stat 'index', which
+  // must be at most num_stats(). This lets histograms held in the stats grow to
+  // the range of values seen.
+  void InsertStats(uint16_t index, uint16_t count);
+
+  // Replaces stats [begin, end) with a single stat, at 'begin', holding their
+  // sum in every bucket. Requires begin < end <= num_stats().
+  void CollapseStats(uint16_t begin, uint16_t end);
+
   // Fast-forwards this object's current time to other's current time if 'other'
   // is ahead of 'this,' then adds all the data from 'other' into this.  If
   // other.num_stats() != this->num_stats() or other.bucket_interval() !=
@@ -193,7 +203,7 @@ class StatsObject {
   const absl::Duration bucket_interval_;
   // We use uint16_t and float for num_stats_, cur_bucket_, and
   // initial_bucket_fraction_filled_ so they'll pack into 8 bytes.
-  const uint16_t num_stats_;
+  uint16_t num_stats_;
   // Index of the current bucket in data_.  That is, the current bucket's data
   // is stored in the num_stats_ elements starting at
   // data_.data() + cur_bucket_ * num_stats_.
@@ -523,6 +533,41 @@ void StatsObject<N>::Merge(const StatsObject<N>& other) {
   }
 }
 
+template <uint16_t N>
+void StatsObject<N>::InsertStats(uint16_t index, uint16_t count) {
+  ABSL_ASSERT(index <= num_stats_);
+  const uint16_t new_num_stats = num_stats_ + count;
+  ABSL_ASSERT(new_num_stats >= num_stats_ && "Too many stats");
+  std::vector<double> data(new_num_stats * NumBuckets());
+  for (uint32_t i = 0; i < NumBuckets(); ++i) {
+    const double* old_bucket = data_.data() + i * num_stats_;
+    double* bucket = data.data() + i * new_num_stats;
+    std::copy(old_bucket, old_bucket + index, bucket);
+    std::copy(old_bucket + index, old_bucket + num_stats_,
+              bucket + index + count);
+  }
+  data_.swap(data);
+  num_stats_ = new_num_stats;
+}
+
+template <uint16_t N>
+void StatsObject<N>::CollapseStats(uint16_t begin, uint16_t end) {
+  ABSL_ASSERT(begin < end && end <= num_stats_);
+  const uint16_t new_num_stats = num_stats_ - (end - begin - 1);
+  // Each bucket moves to a lower index, so this can work in place.
+  for (uint32_t i = 0; i < NumBuckets(); ++i) {
+    const double* old_bucket = data_.data() + i * num_stats_;
+    double* bucket = data_.data() + i * new_num_stats;
+    const double sum =
+        std::accumulate(old_bucket + begin, old_bucket + end, 0.0);
+    std::copy(old_bucket, old_bucket + begin, bucket);
+    bucket[begin] = sum;
+    std::copy(old_bucket + end, old_bucket + num_stats_, bucket + begin + 1);
+  }
+  data_.resize(new_num_stats * NumBuckets());
+  num_stats_ = new_num_stats;
+}
+
 template <uint16_t N>
 std::string StatsObject<N>::DebugString() const {
   std::string s =
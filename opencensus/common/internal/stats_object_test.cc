@@ -233,6 +233,28 @@ TEST(StatsObjectTest, Add) {
   }
 }
 
+TEST(StatsObjectTest, InsertAndCollapseStats) {
+  const absl::Time t0 = absl::UnixEpoch();
+  StatsObject<4> obj(2, absl::Hours(1), t0);
+  obj.Add({1, 2}, t0);
+  const absl::Time t1 = t0 + obj.bucket_interval() + epsilon;
+  obj.Add({3, 4}, t1);
+
+  obj.InsertStats(1, 2);
+  EXPECT_EQ(4, obj.num_stats());
+  CheckSum(obj, t1, {4, 0, 0, 6});
+  obj.InsertStats(4, 1);
+  obj.Add({1, 1, 1, 1, 1}, t1);
+  CheckSum(obj, t1, {5, 1, 1, 7, 1});
+
+  obj.CollapseStats(1, 4);
+  EXPECT_EQ(3, obj.num_stats());
+  CheckSum(obj, t1, {5, 9, 1});
+  // Each bucket was collapsed separately, so older data still expires.
+  const absl::Time t2 = t0 + obj.total_interval() + obj.bucket_interval();
+  CheckSum(obj, t2 + epsilon, {4, 7, 1});
+}
+
 // Merge obj2 into obj1, where obj2 is much older than obj1.
 TEST(StatsObjectTest, MergeVeryOld) {
   const absl::Time t0 = absl::UnixEpoch();
@@ -43,8 +43,9 @@ std::string SanitizeName(absl::string_view name) {
   return sanitized;
 }
 
-prometheus::MetricType MetricType(opencensus::stats::Aggregation::Type type) {
-  switch (type) {
+prometheus::MetricType MetricType(
+    const opencensus::stats::Aggregation& aggregation) {
+  switch (aggregation.type()) {
     case opencensus::stats::Aggregation::Type::kCount:
       return prometheus::MetricType::Counter;
     case opencensus::stats::Aggregation::Type::kSum:
@@ -52,14 +53,17 @@ prometheus::MetricType MetricType(opencensus::stats::Aggregation::Type type) {
     case opencensus::stats::Aggregation::Type::kLastValue:
       return prometheus::MetricType::Gauge;
     case opencensus::stats::Aggregation::Type::kDistribution:
-      return prometheus::MetricType::Histogram;
+      // Quantile sketches are exported as their quantiles.
+      return aggregation.max_buckets_per_row() > 0
+                 ? prometheus::MetricType::Summary
+                 : prometheus::MetricType::Histogram;
   }
   ABSL_ASSERT(false && "Bad MetricType.");
   return prometheus::MetricType::Untyped;
 }
 
-void SetValue(double value, prometheus::MetricType type,
-              prometheus::ClientMetric* metric) {
+void SetValue(double value, const opencensus::stats::Aggregation& aggregation,
+              prometheus::MetricType type, prometheus::ClientMetric* metric) {
   if (type == prometheus::MetricType::Untyped) {
     metric->untyped.value = value;
   } else {
@@ -68,8 +72,8 @@ void SetValue(double value, prometheus::MetricType type,
   }
 }
 
-void SetValue(int64_t value, prometheus::MetricType type,
-              prometheus::ClientMetric* metric) {
+void SetValue(int64_t value, const opencensus::stats::Aggregation& aggregation,
+              prometheus::MetricType type, prometheus::ClientMetric* metric) {
   switch (type) {
     case prometheus::MetricType::Counter: {
       metric->counter.value = value;
@@ -89,24 +93,54 @@ void SetValue(int64_t value, prometheus::MetricType type,
 }
 
 void SetValue(const opencensus::stats::Distribution& value,
-              prometheus::MetricType type ABSL_ATTRIBUTE_UNUSED,
-              prometheus::ClientMetric* metric) {
+              const opencensus::stats::Aggregation& aggregation,
+              prometheus::MetricType type, prometheus::ClientMetric* metric) {
+  if (type == prometheus::MetricType::Summary) {
+    auto& summary = metric->summary;
+    summary.sample_count = value.count();
+    summary.sample_sum = value.count() * value.mean();
+    summary.quantile.reserve(aggregation.quantiles().size());
+    for (const double quantile : aggregation.quantiles()) {
+      summary.quantile.emplace_back();
+      summary.quantile.back().quantile = quantile;
+      summary.quantile.back().value = value.Quantile(quantile);
+    }
+    return;
+  }
+  ABSL_ASSERT(type == prometheus::MetricType::Histogram);
   auto& histogram = metric->histogram;
   histogram.sample_count = value.count();
   histogram.sample_sum = value.count() * value.mean();
 
+  // Auto-ranging distributions omit the empty buckets outside
+  // bucket_counts(). Those below it are emitted anyway, so that the 'le'
+  // bounds of a series do not depend on its lowest value; histogram_quantile()
+  // over rate() windows needs the bounds to stay the same across scrapes.
+  const std::vector<double>& boundaries =
+      value.bucket_boundaries().lower_boundaries();
+  const int offset = value.bucket_offset();
+  const int end = offset + value.bucket_counts().size();
   int64_t cumulative_count = 0;
-  histogram.bucket.reserve(value.bucket_boundaries().num_buckets());
-  for (int i = 0; i < value.bucket_boundaries().num_buckets(); ++i) {
-    cumulative_count += value.bucket_counts()[i];
+  histogram.bucket.reserve(end + 1);
+  for (int bucket = 0; bucket < end; ++bucket) {
+    if (bucket >= offset) {
+      cumulative_count += value.bucket_counts()[bucket - offset];
+    }
     histogram.bucket.emplace_back();
-    histogram.bucket[i].cumulative_count = cumulative_count;
+    histogram.bucket.back().cumulative_count = cumulative_count;
     // We use lower boundaries plus an underflow bucket; Prometheus uses upper
     // boundaries, including a +Inf boundary.
-    histogram.bucket[i].upper_bound =
-        i < value.bucket_boundaries().lower_boundaries().size()
-            ? value.bucket_boundaries().lower_boundaries()[i]
-            : std::numeric_limits<double>::infinity();
+    histogram.bucket.back().upper_bound =
+        bucket < boundaries.size() ? boundaries[bucket]
+                                   : std::numeric_limits<double>::infinity();
+  }
+  if (histogram.bucket.empty() ||
+      histogram.bucket.back().upper_bound !=
+          std::numeric_limits<double>::infinity()) {
+    histogram.bucket.emplace_back();
+    histogram.bucket.back().cumulative_count = cumulative_count;
+    histogram.bucket.back().upper_bound =
+        std::numeric_limits<double>::infinity();
   }
 }
 
@@ -125,7 +159,7 @@ void SetData(const opencensus::stats::ViewDescriptor& descriptor,
       metric.label[i].name = SanitizeName(descriptor.columns()[i].name());
       metric.label[i].value = row.first[i];
     }
-    SetValue(row.second, type, &metric);
+    SetValue(row.second, descriptor.aggregation(), type, &metric);
   }
 }
 
@@ -134,8 +168,7 @@ void SetData(const opencensus::stats::ViewDescriptor& descriptor,
 void SetMetricFamily(const opencensus::stats::ViewDescriptor& descriptor,
                      const opencensus::stats::ViewData& data,
                      prometheus::MetricFamily* metric_family) {
-  const prometheus::MetricType type =
-      MetricType(descriptor.aggregation().type());
+  const prometheus::MetricType type = MetricType(descriptor.aggregation());
   // TODO(sturdy): convert common units into base units (e.g. ms->s).
   metric_family->name = SanitizeName(absl::StrCat(
       descriptor.name(), "_", descriptor.measure_descriptor().units()));
@@ -565,6 +565,94 @@ TEST(StackdriverUtilsTest, MakeTimeSeriesDistributionDouble) {
                                                   infinity())))))))))));
 }
 
+TEST(SetMetricFamilyTest, LogLinearHistogram) {
+  const auto measure = opencensus::stats::MeasureDouble::Register(
+      "measure_log_linear_histogram", "", "units");
+  const auto tag_key = opencensus::tags::TagKey::Register("foo");
+  const auto aggregation =
+      opencensus::stats::Aggregation::LogLinearHistogram(1);
+  const auto view_descriptor =
+      opencensus::stats::ViewDescriptor()
+          .set_name("test_descriptor")
+          .set_measure(measure.GetDescriptor().name())
+          .set_aggregation(aggregation)
+          .add_column(tag_key);
+  const opencensus::stats::ViewData data = TestUtils::MakeViewData(
+      view_descriptor, {{{"v1"}, 3.0}, {{"v1"}, 5.0}, {{"v2"}, 100.0}});
+  prometheus::MetricFamily actual;
+  SetMetricFamily(view_descriptor, data, &actual);
+
+  EXPECT_EQ(prometheus::MetricType::Histogram, actual.type);
+  ASSERT_EQ(2, actual.metric.size());
+  const opencensus::stats::BucketBoundaries& buckets =
+      aggregation.bucket_boundaries();
+  const std::vector<double>& bounds = buckets.lower_boundaries();
+  for (const auto& metric : actual.metric) {
+    ASSERT_EQ(1, metric.label.size());
+    const bool v1 = metric.label[0].value == "v1";
+    const auto& histogram_buckets = metric.histogram.bucket;
+    // Every bucket up to the highest populated one is emitted, whatever the
+    // lowest populated one, followed by +Inf.
+    const int highest = buckets.BucketForValue(v1 ? 5.0 : 100.0);
+    ASSERT_EQ(highest + 2, histogram_buckets.size());
+    for (int i = 0; i <= highest; ++i) {
+      EXPECT_EQ(bounds[i], histogram_buckets[i].upper_bound);
+    }
+    EXPECT_EQ(std::numeric_limits<double>::infinity(),
+              histogram_buckets.back().upper_bound);
+    EXPECT_EQ(v1 ? 2 : 1, histogram_buckets.back().cumulative_count);
+    EXPECT_EQ(0, histogram_buckets.front().cumulative_count);
+    if (v1) {
+      const int lowest = buckets.BucketForValue(3.0);
+      EXPECT_EQ(0, histogram_buckets[lowest - 1].cumulative_count);
+      EXPECT_EQ(1, histogram_buckets[lowest].cumulative_count);
+    }
+  }
+}
+
+TEST(SetMetricFamilyTest, QuantileSketch) {
+  const auto measure = opencensus::stats::MeasureDouble::Register(
+      "measure_quantile_sketch", "", "units");
+  const auto tag_key = opencensus::tags::TagKey::Register("foo");
+  const auto view_descriptor =
+      opencensus::stats::ViewDescriptor()
+          .set_name("test_descriptor")
+          .set_measure(measure.GetDescriptor().name())
+          .set_aggregation(opencensus::stats::Aggregation::QuantileSketch(
+              3, 100, {0, 0.5, 0.99}))
+          .add_column(tag_key);
+  const opencensus::stats::ViewData data = TestUtils::MakeViewData(
+      view_descriptor, {{{"v1"}, 10.0},
+                        {{"v1"}, 20.0},
+                        {{"v1"}, 30.0},
+                        {{"v1"}, 40.0},
+                        {{"v1"}, 50.0},
+                        {{"v1"}, 60.0},
+                        {{"v1"}, 70.0},
+                        {{"v1"}, 80.0},
+                        {{"v1"}, 90.0},
+                        {{"v1"}, 100.0}});
+  prometheus::MetricFamily actual;
+  SetMetricFamily(view_descriptor, data, &actual);
+
+  EXPECT_EQ(prometheus::MetricType::Summary, actual.type);
+  ASSERT_EQ(1, actual.metric.size());
+  const auto& summary = actual.metric[0].summary;
+  EXPECT_EQ(10, summary.sample_count);
+  EXPECT_DOUBLE_EQ(550, summary.sample_sum);
+  // The configured quantiles, in order, each between the values at the
+  // neighbouring ranks up to the sketch's relative error of 2^-4.
+  ASSERT_EQ(3, summary.quantile.size());
+  EXPECT_EQ(0, summary.quantile[0].quantile);
+  EXPECT_EQ(10, summary.quantile[0].value);
+  EXPECT_EQ(0.5, summary.quantile[1].quantile);
+  EXPECT_LE(50 * (1 - 1.0 / 16), summary.quantile[1].value);
+  EXPECT_GE(60 * (1 + 1.0 / 16), summary.quantile[1].value);
+  EXPECT_EQ(0.99, summary.quantile[2].quantile);
+  EXPECT_LE(90 * (1 - 1.0 / 16), summary.quantile[2].value);
+  EXPECT_GE(100 * (1 + 1.0 / 16), summary.quantile[2].value);
+}
+
 }  // namespace
 }  // namespace stats
 }  // namespace exporters
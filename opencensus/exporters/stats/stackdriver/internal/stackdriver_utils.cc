@@ -14,7 +14,9 @@
 
 #include "opencensus/exporters/stats/stackdriver/internal/stackdriver_utils.h"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "absl/base/internal/sysinfo.h"
 #include "absl/base/macros.h"
@@ -117,11 +119,33 @@ void SetTypedValue(const opencensus::stats::Distribution& value,
   if (value.bucket_boundaries().num_buckets() > 1) {
     auto* buckets = distribution_proto->mutable_bucket_options()
                         ->mutable_explicit_buckets();
-    for (const auto boundary : value.bucket_boundaries().lower_boundaries()) {
-      buckets->add_bounds(boundary);
+    // Auto-ranging distributions only have counts for the populated buckets,
+    // so the bounds are limited to those buckets, with an empty bucket on
+    // either side where they do not reach the underflow or overflow bucket.
+    const std::vector<double>& boundaries =
+        value.bucket_boundaries().lower_boundaries();
+    const int offset = value.bucket_offset();
+    const int end = offset + value.bucket_counts().size();
+    // Quantile sketches collapse their lowest buckets into the first counted
+    // bucket, so it extends down to the bucket holding min().
+    const int first =
+        value.count() > 0
+            ? std::min(offset,
+                       value.bucket_boundaries().BucketForValue(value.min()))
+            : offset;
+    if (first > 0) {
+      buckets->add_bounds(boundaries[first - 1]);
+      distribution_proto->add_bucket_counts(0);
     }
-    for (const auto bucket_count : value.bucket_counts()) {
-      distribution_proto->add_bucket_counts(bucket_count);
+    for (int bucket = offset; bucket < end; ++bucket) {
+      if (bucket < boundaries.size()) {
+        buckets->add_bounds(boundaries[bucket]);
+      }
+      distribution_proto->add_bucket_counts(
+          value.bucket_counts()[bucket - offset]);
+    }
+    if (end < value.bucket_boundaries().num_buckets()) {
+      distribution_proto->add_bucket_counts(0);
     }
   }
 }
@@ -129,6 +153,7 @@ void SetTypedValue(const opencensus::stats::Distribution& value,
 template <typename DataValueT>
 std::vector<google::monitoring::v3::TimeSeries> DataToTimeSeries(
     const opencensus::stats::ViewDescriptor& view_descriptor,
+    const opencensus::stats::ViewData& view_data,
     const opencensus::stats::ViewData::DataMap<DataValueT>& data,
     const google::monitoring::v3::TimeSeries& base_time_series) {
   const google::api::MetricDescriptor::ValueType type =
@@ -143,6 +168,13 @@ std::vector<google::monitoring::v3::TimeSeries> DataToTimeSeries(
           row.first[i];
     }
     // The point is already created in the base_time_series to set the times.
+    if (view_descriptor.row_ttl() != absl::InfiniteDuration()) {
+      // Rows restart after expiring.
+      SetTimestamp(view_data.row_start_time(row.first),
+                   time_series.mutable_points(0)
+                       ->mutable_interval()
+                       ->mutable_start_time());
+    }
     SetTypedValue(row.second, type,
                   time_series.mutable_points(0)->mutable_value());
   }
@@ -190,13 +222,13 @@ std::vector<google::monitoring::v3::TimeSeries> MakeTimeSeries(
 
   switch (data.type()) {
     case opencensus::stats::ViewData::Type::kDouble:
-      return DataToTimeSeries(view_descriptor, data.double_data(),
+      return DataToTimeSeries(view_descriptor, data, data.double_data(),
                               base_time_series);
     case opencensus::stats::ViewData::Type::kInt64:
-      return DataToTimeSeries(view_descriptor, data.int_data(),
+      return DataToTimeSeries(view_descriptor, data, data.int_data(),
                               base_time_series);
     case opencensus::stats::ViewData::Type::kDistribution:
-      return DataToTimeSeries(view_descriptor, data.distribution_data(),
+      return DataToTimeSeries(view_descriptor, data, data.distribution_data(),
                               base_time_series);
   }
   ABSL_ASSERT(false && "Bad ViewData.type().");
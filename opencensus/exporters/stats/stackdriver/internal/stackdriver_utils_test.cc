@@ -350,6 +350,44 @@ TEST(StackdriverUtilsTest, MakeTimeSeriesDistributionDouble) {
                                                   distribution2)));
 }
 
+TEST(StackdriverUtilsTest, MakeTimeSeriesLogLinearHistogram) {
+  const auto measure = opencensus::stats::MeasureDouble::Register(
+      "measure_log_linear_histogram", "", "");
+  const auto aggregation =
+      opencensus::stats::Aggregation::LogLinearHistogram(1);
+  const auto view_descriptor =
+      opencensus::stats::ViewDescriptor()
+          .set_name("test_view")
+          .set_measure(measure.GetDescriptor().name())
+          .set_aggregation(aggregation);
+  const opencensus::stats::ViewData data =
+      TestUtils::MakeViewData(view_descriptor, {{{}, 3.0}, {{}, 5.0}});
+  const std::vector<google::monitoring::v3::TimeSeries> time_series =
+      MakeTimeSeries(view_descriptor, data, "test_task");
+
+  ASSERT_EQ(1, time_series.size());
+  ASSERT_EQ(1, time_series[0].points_size());
+  const google::api::Distribution& distribution =
+      time_series[0].points(0).value().distribution_value();
+  EXPECT_EQ(2, distribution.count());
+  // Only the populated buckets are exported, with an empty bucket on either
+  // side.
+  const opencensus::stats::BucketBoundaries& buckets =
+      aggregation.bucket_boundaries();
+  const int first = buckets.BucketForValue(3.0);
+  const int last = buckets.BucketForValue(5.0);
+  const auto& bounds = distribution.bucket_options().explicit_buckets();
+  ASSERT_EQ(last - first + 2, bounds.bounds_size());
+  ASSERT_EQ(last - first + 3, distribution.bucket_counts_size());
+  for (int i = 0; i < bounds.bounds_size(); ++i) {
+    EXPECT_EQ(buckets.lower_boundaries()[first - 1 + i], bounds.bounds(i));
+  }
+  EXPECT_EQ(0, distribution.bucket_counts(0));
+  EXPECT_EQ(1, distribution.bucket_counts(1));
+  EXPECT_EQ(1, distribution.bucket_counts(last - first + 1));
+  EXPECT_EQ(0, distribution.bucket_counts(last - first + 2));
+}
+
 }  // namespace
 }  // namespace stats
 }  // namespace exporters
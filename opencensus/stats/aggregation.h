@@ -17,6 +17,7 @@
 
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "opencensus/stats/bucket_boundaries.h"
 
@@ -47,6 +48,34 @@ class Aggregation final {
     return Aggregation(Type::kDistribution, std::move(buckets));
   }
 
+  // LogLinearHistogram aggregation is a Distribution aggregation over
+  // BucketBoundaries::LogLinear(precision): its histogram covers many orders
+  // of magnitude with a relative error of at most 2^-precision, and stores
+  // only the range of populated buckets. The buckets only cover [2^-32, 2^32)
+  // (about 2.3e-10 to 4.3e9); values outside that range fall into the
+  // underflow and overflow buckets, so record in units that keep values within
+  // it (e.g. milliseconds rather than nanoseconds for latencies). Interval
+  // views likewise keep only the range of buckets populated in each row.
+  static Aggregation LogLinearHistogram(int precision) {
+    return Aggregation(Type::kDistribution,
+                       BucketBoundaries::LogLinear(precision));
+  }
+
+  // QuantileSketch aggregation is a LogLinearHistogram(precision) aggregation
+  // that keeps at most 'max_buckets' histogram buckets per row, collapsing the
+  // lowest buckets into one as needed, as in DDSketch
+  // (https://arxiv.org/abs/1908.10693). Distribution::Quantile() estimates
+  // quantiles with a relative error of at most 2^-(precision + 1), except for
+  // quantiles falling in the collapsed lowest bucket, so high quantiles stay
+  // accurate. 'max_buckets' must be positive. Rows of cumulative views, and
+  // each window of the rows of interval views, hold at most 'max_buckets'
+  // counts; the per-harvest deltas hold only the buckets populated since the
+  // last harvest. Exporters that report quantiles rather than the histogram
+  // (e.g. as a Prometheus summary) report 'quantiles', each in [0, 1].
+  static Aggregation QuantileSketch(
+      int precision, int max_buckets,
+      std::vector<double> quantiles = {0.5, 0.9, 0.99, 0.999});
+
   // LastValue aggregation returns the last value recorded.
   static Aggregation LastValue() {
     return Aggregation(Type::kLastValue, BucketBoundaries::Explicit({}));
@@ -63,22 +92,38 @@ class Aggregation final {
   const BucketBoundaries& bucket_boundaries() const {
     return bucket_boundaries_;
   }
+  // The maximum number of histogram buckets per row for QuantileSketch()
+  // aggregations, and 0 for all others.
+  int max_buckets_per_row() const { return max_buckets_per_row_; }
+  // The quantiles to export for QuantileSketch() aggregations, and empty for
+  // all others.
+  const std::vector<double>& quantiles() const { return quantiles_; }
 
   std::string DebugString() const;
 
   bool operator==(const Aggregation& other) const {
     return type_ == other.type_ &&
-           bucket_boundaries_ == other.bucket_boundaries_;
+           bucket_boundaries_ == other.bucket_boundaries_ &&
+           max_buckets_per_row_ == other.max_buckets_per_row_ &&
+           quantiles_ == other.quantiles_;
   }
   bool operator!=(const Aggregation& other) const { return !(*this == other); }
 
  private:
-  Aggregation(Type type, BucketBoundaries buckets)
-      : type_(type), bucket_boundaries_(std::move(buckets)) {}
+  Aggregation(Type type, BucketBoundaries buckets,
+              int max_buckets_per_row = 0,
+              std::vector<double> quantiles = {})
+      : type_(type),
+        bucket_boundaries_(std::move(buckets)),
+        max_buckets_per_row_(max_buckets_per_row),
+        quantiles_(std::move(quantiles)) {}
 
   Type type_;
   // Ignored except if type_ == kDistribution.
   BucketBoundaries bucket_boundaries_;
+  // 0 for no limit.
+  int max_buckets_per_row_;
+  std::vector<double> quantiles_;
 };
 
 }  // namespace stats
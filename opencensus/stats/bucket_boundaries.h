@@ -15,6 +15,7 @@
 #ifndef OPENCENSUS_STATS_BUCKET_BOUNDARIES_H_
 #define OPENCENSUS_STATS_BUCKET_BOUNDARIES_H_
 
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -24,7 +25,9 @@ namespace stats {
 
 // BucketBoundaries defines the bucket boundaries for distribution
 // aggregations.
-// BucketBoundaries is a value type, and is thread-compatible.
+// BucketBoundaries is a value type, and is thread-compatible. Equal boundaries
+// share one immutable copy, so copying and comparing BucketBoundaries are
+// cheap.
 class BucketBoundaries final {
  public:
   // Creates a BucketBoundaries with num_finite_buckets each 'width' wide,
@@ -52,31 +55,85 @@ class BucketBoundaries final {
   // [boundaries[boundaries.size()-1], inf].
   static BucketBoundaries Explicit(std::vector<double> boundaries);
 
+  // Creates a BucketBoundaries that splits each power of two from 2^-32 to
+  // 2^32 into 2^precision buckets of equal width, as well as an underflow
+  // bucket covering [-inf, 2^-32) (including zero and negative values) and an
+  // overflow bucket covering [2^32, inf]. Any value within the finite buckets
+  // is within a factor of 2^-precision of its bucket's lower bound. 'precision'
+  // must be in [0, kMaxLogLinearPrecision].
+  //
+  // There are many such buckets, so Distributions using these boundaries store
+  // counts only for the range of populated buckets; see
+  // Distribution::bucket_offset().
+  static BucketBoundaries LogLinear(int precision);
+  static constexpr int kMaxLogLinearPrecision = 7;
+
   // The number of buckets in a Distribution using this bucketer.
-  int num_buckets() const { return lower_boundaries_.size() + 1; }
+  int num_buckets() const { return rep_->lower_boundaries.size() + 1; }
   // The index of the bucket for a given value, in [0, num_buckets() - 1].
+  // Linear and exponential boundaries compute the index arithmetically rather
+  // than searching, and short explicit lists compare the value against every
+  // boundary at once using SIMD instructions where available.
   int BucketForValue(double value) const;
 
   const std::vector<double>& lower_boundaries() const {
-    return lower_boundaries_;
+    return rep_->lower_boundaries;
   }
 
+  // Whether Distributions using these boundaries store counts only for the
+  // range of populated buckets. True for LogLinear() boundaries.
+  bool auto_ranging() const { return rep_->kind == Kind::kLogLinear; }
+
   std::string DebugString() const;
 
   bool operator==(const BucketBoundaries& other) const {
-    return lower_boundaries_ == other.lower_boundaries_;
+    return rep_ == other.rep_;
   }
   bool operator!=(const BucketBoundaries& other) const {
     return !(*this == other);
   }
 
  private:
-  BucketBoundaries(std::vector<double> lower_boundaries)
-      : lower_boundaries_(std::move(lower_boundaries)) {}
+  enum class Kind { kExplicit, kLinear, kExponential, kLogLinear };
+
+  struct Rep {
+    // The lower bound of each bucket, excluding the underflow bucket but
+    // including the overflow bucket.
+    std::vector<double> lower_boundaries;
+
+    // How the boundaries were generated. For kLinear, 'origin' is the offset
+    // and 'inverse_step' is 1 / width. For kExponential, 'origin' is 1 / scale
+    // and 'inverse_step' is 1 / log2(growth_factor). For kLogLinear,
+    // 'precision' is the number of mantissa bits that select the bucket within
+    // a power of two.
+    Kind kind = Kind::kExplicit;
+    double origin = 0;
+    double inverse_step = 0;
+    int precision = 0;
+
+    // For short explicit lists, lower_boundaries padded with infinities to a
+    // whole number of SIMD chunks; otherwise empty.
+    std::vector<double> padded_boundaries;
+  };
+
+  explicit BucketBoundaries(std::shared_ptr<const Rep> rep)
+      : rep_(std::move(rep)) {}
+
+  // Returns the BucketBoundaries sharing the registered Rep with the same
+  // lower_boundaries as 'rep', registering 'rep' if there is none. The first
+  // Rep registered for some boundaries is used even if a later one was
+  // generated differently, since they find the same buckets.
+  static BucketBoundaries Intern(Rep rep);
+
+  // Returns an estimate of BucketForValue(value), for a value within the
+  // finite buckets.
+  int EstimateBucket(double value) const;
+
+  // Returns BucketForValue(value) for LogLinear() boundaries.
+  int LogLinearBucket(double value) const;
 
-  // The lower bound of each bucket, excluding the underflow bucket but
-  // including the overflow bucket.
-  std::vector<double> lower_boundaries_;
+  // Never null.
+  std::shared_ptr<const Rep> rep_;
 };
 
 }  // namespace stats
@@ -39,7 +39,15 @@ class TestUtils;
 // Distribution is thread-compatible.
 class Distribution final {
  public:
+  // The counts of values in consecutive buckets of bucket_boundaries(),
+  // starting with the bucket with index bucket_offset(). For auto-ranging
+  // boundaries (see BucketBoundaries::auto_ranging()) these span only the
+  // populated buckets, and all other buckets are empty; otherwise there is a
+  // count for every bucket and bucket_offset() is 0. For
+  // Aggregation::QuantileSketch() the first count also includes any collapsed
+  // lower buckets, down to the bucket holding min().
   const std::vector<uint64_t>& bucket_counts() const { return bucket_counts_; }
+  int bucket_offset() const { return bucket_offset_; }
 
   uint64_t count() const { return count_; }
   double mean() const { return mean_; }
@@ -49,6 +57,13 @@ class Distribution final {
 
   const BucketBoundaries& bucket_boundaries() const { return *buckets_; }
 
+  // Returns an estimate of the 'quantile' quantile (in [0, 1]) of the values,
+  // or NaN if there are none. The estimate is in the bucket holding that
+  // quantile, and within [min(), max()]. For auto-ranging boundaries (e.g. from
+  // Aggregation::QuantileSketch()) it is the value minimizing the worst-case
+  // relative error over that bucket; otherwise it is interpolated linearly.
+  double Quantile(double quantile) const;
+
   // A string representation of the Distribution's data suitable for human
   // consumption.
   std::string DebugString() const;
@@ -65,6 +80,16 @@ class Distribution final {
   // non-finite values may make statistics meaningless.
   void Add(double value);
 
+  // Extends bucket_counts_ to cover at least buckets [begin, end), which must
+  // be non-empty. Requires buckets_->auto_ranging().
+  void ExtendBuckets(int begin, int end);
+  // Drops empty buckets from both ends of bucket_counts_. Requires
+  // buckets_->auto_ranging().
+  void TrimBuckets();
+  // Merges the lowest buckets into one so that at most 'max_buckets' remain.
+  // Requires buckets_->auto_ranging().
+  void CollapseBuckets(int max_buckets);
+
   const BucketBoundaries* const buckets_;  // Never null; not owned.
 
   uint64_t count_ = 0;
@@ -73,9 +98,11 @@ class Distribution final {
   double min_ = std::numeric_limits<double>::infinity();
   double max_ = -std::numeric_limits<double>::infinity();
 
-  // The counts of values in the buckets listed in buckets_. Size is
-  // buckets_->num_buckets().
+  // The counts of values in the buckets listed in buckets_, starting with
+  // bucket bucket_offset_. Size is buckets_->num_buckets() unless
+  // buckets_->auto_ranging().
   std::vector<uint64_t> bucket_counts_;
+  int bucket_offset_ = 0;
 };
 
 }  // namespace stats
@@ -15,12 +15,36 @@
 #include "opencensus/stats/aggregation.h"
 
 #include <cassert>
+#include <iostream>
 
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 
 namespace opencensus {
 namespace stats {
 
+// static
+Aggregation Aggregation::QuantileSketch(int precision, int max_buckets,
+                                        std::vector<double> quantiles) {
+  if (max_buckets <= 0) {
+    std::cerr << "Aggregation::QuantileSketch called with non-positive "
+                 "max_buckets.\n";
+    assert(false);
+    max_buckets = 1;
+  }
+  for (double& quantile : quantiles) {
+    if (!(quantile >= 0 && quantile <= 1)) {
+      std::cerr << "Aggregation::QuantileSketch called with quantile "
+                << quantile << " outside [0, 1].\n";
+      assert(false);
+      quantile = quantile > 1 ? 1 : 0;
+    }
+  }
+  return Aggregation(Type::kDistribution,
+                     BucketBoundaries::LogLinear(precision), max_buckets,
+                     std::move(quantiles));
+}
+
 std::string Aggregation::DebugString() const {
   switch (type_) {
     case Type::kCount:
@@ -28,6 +52,12 @@ std::string Aggregation::DebugString() const {
     case Type::kSum:
       return "Sum";
     case Type::kDistribution:
+      if (max_buckets_per_row_ > 0) {
+        return absl::StrCat("Quantile sketch with ",
+                            bucket_boundaries_.DebugString(), ", at most ",
+                            max_buckets_per_row_, " per row, quantiles ",
+                            absl::StrJoin(quantiles_, ", "));
+      }
       return absl::StrCat("Distribution with ",
                           bucket_boundaries_.DebugString());
     case Type::kLastValue:
@@ -15,66 +15,358 @@
 #include "opencensus/stats/bucket_boundaries.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <unordered_map>
 #include <vector>
 
 #include "absl/base/macros.h"
+#include "absl/hash/hash.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define OPENCENSUS_BUCKET_BOUNDARIES_X86 1
+#include <immintrin.h>
+#endif
 
 namespace opencensus {
 namespace stats {
 
-// Class-level todos:
-// TODO: Consider lazy generation of storage buckets, to save memory
-// when few buckets are populated.
-// TODO: Share bucketers, or at least the lower_boundaries_ vector, to
-// reduce allocation/copying for copies of Aggregation objects.
+namespace {
+
+// Approximates log2(value) for value >= 1 to within 0.01 from the exponent and
+// mantissa bits of 'value', which is much faster than std::log2().
+double ApproximateLog2(double value) {
+  uint64_t bits;
+  static_assert(sizeof(bits) == sizeof(value), "Unexpected double size.");
+  memcpy(&bits, &value, sizeof(bits));
+  const int exponent = static_cast<int>(bits >> 52) - 1023;
+  // Replace the exponent to get the mantissa, in [1, 2).
+  bits = (bits & ((uint64_t{1} << 52) - 1)) | (uint64_t{1023} << 52);
+  double mantissa;
+  memcpy(&mantissa, &bits, sizeof(mantissa));
+  // A quadratic fit of log2 on [1, 2], exact at both ends.
+  const double x = mantissa - 1;
+  return exponent + x * (1.34 - 0.34 * x);
+}
+
+// Exponential() boundaries are searched instead of estimated when
+// 1 / log2(growth_factor) exceeds this, i.e. for growth factors below about
+// 1.044: ApproximateLog2()'s error, scaled by it, would otherwise leave the
+// estimate several buckets off.
+constexpr double kMaxExponentialInverseStep = 16;
+
+// LogLinear() boundaries cover [2^kLogLinearMinExponent,
+// 2^kLogLinearMaxExponent).
+constexpr int kLogLinearMinExponent = -32;
+constexpr int kLogLinearMaxExponent = 32;
+
+// Boundaries are compared in chunks of this many, to fill an AVX register.
+constexpr int kChunkSize = 4;
+// Up to this many boundaries, comparing the value against all of them is
+// faster than a binary search, and avoids its branch mispredictions.
+constexpr int kMaxComparedBoundaries = 32;
+
+// The following return the number of 'boundaries' (of which there are 'size',
+// a multiple of kChunkSize) that 'value' is not less than. This is the number
+// of boundaries at or below 'value', or all of them for NaN, matching
+// std::upper_bound().
+#ifdef OPENCENSUS_BUCKET_BOUNDARIES_X86
+// SSE2 is part of the x86-64 baseline.
+int CountBoundariesSse2(const double* boundaries, int size, double value) {
+  const __m128d values = _mm_set1_pd(value);
+  // Matching lanes compare to all ones, i.e. -1. Two accumulators shorten the
+  // dependency chain.
+  __m128i counts1 = _mm_setzero_si128();
+  __m128i counts2 = _mm_setzero_si128();
+  for (int i = 0; i < size; i += 4) {
+    counts1 = _mm_sub_epi64(
+        counts1,
+        _mm_castpd_si128(_mm_cmpnlt_pd(values, _mm_loadu_pd(boundaries + i))));
+    counts2 = _mm_sub_epi64(
+        counts2, _mm_castpd_si128(
+                     _mm_cmpnlt_pd(values, _mm_loadu_pd(boundaries + i + 2))));
+  }
+  const __m128i counts = _mm_add_epi64(counts1, counts2);
+  return _mm_cvtsi128_si64(counts) +
+         _mm_cvtsi128_si64(_mm_unpackhi_epi64(counts, counts));
+}
+
+#if defined(__GNUC__)
+// Compiled for AVX regardless of the target, and only called if the CPU
+// supports it.
+__attribute__((target("avx"))) int CountBoundariesAvx(
+    const double* boundaries, int size, double value) {
+  const __m256d values = _mm256_set1_pd(value);
+  const __m256d ones = _mm256_set1_pd(1);
+  __m256d counts = _mm256_setzero_pd();
+  for (int i = 0; i < size; i += 4) {
+    const __m256d not_less = _mm256_cmp_pd(
+        values, _mm256_loadu_pd(boundaries + i), _CMP_NLT_UQ);
+    counts = _mm256_add_pd(counts, _mm256_and_pd(not_less, ones));
+  }
+  const __m128d sums = _mm_add_pd(_mm256_castpd256_pd128(counts),
+                                  _mm256_extractf128_pd(counts, 1));
+  return static_cast<int>(
+      _mm_cvtsd_f64(_mm_add_sd(sums, _mm_unpackhi_pd(sums, sums))));
+}
+
+bool CpuSupportsAvx() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx");
+}
+#endif  // defined(__GNUC__)
+#endif  // OPENCENSUS_BUCKET_BOUNDARIES_X86
+
+int CountBoundaries(const std::vector<double>& boundaries, double value) {
+#ifdef OPENCENSUS_BUCKET_BOUNDARIES_X86
+#if defined(__GNUC__)
+  // Selects the implementation once; branching on the result is cheaper than
+  // calling through a function pointer.
+  static const bool avx = CpuSupportsAvx();
+  if (avx) {
+    return CountBoundariesAvx(boundaries.data(), boundaries.size(), value);
+  }
+#endif
+  return CountBoundariesSse2(boundaries.data(), boundaries.size(), value);
+#else
+  int count = 0;
+  for (const double boundary : boundaries) {
+    count += !(value < boundary);
+  }
+  return count;
+#endif
+}
+
+}  // namespace
 
 // static
 BucketBoundaries BucketBoundaries::Linear(int num_finite_buckets, double offset,
                                           double width) {
-  std::vector<double> boundaries(num_finite_buckets + 1);
+  Rep rep;
+  rep.lower_boundaries.resize(num_finite_buckets + 1);
   double boundary = offset;
   for (int i = 0; i <= num_finite_buckets; ++i) {
-    boundaries[i] = boundary;
+    rep.lower_boundaries[i] = boundary;
     boundary += width;
   }
-  return BucketBoundaries(std::move(boundaries));
+  if (num_finite_buckets > 0 && width > 0 && std::isfinite(1 / width)) {
+    rep.kind = Kind::kLinear;
+    rep.origin = offset;
+    rep.inverse_step = 1 / width;
+  }
+  return Intern(std::move(rep));
 }
 
 // static
 BucketBoundaries BucketBoundaries::Exponential(int num_finite_buckets,
                                                double scale,
                                                double growth_factor) {
-  std::vector<double> boundaries(num_finite_buckets + 1);
+  Rep rep;
+  rep.lower_boundaries.resize(num_finite_buckets + 1);
   double upper_bound = scale;
   for (int i = 1; i <= num_finite_buckets; ++i) {
-    boundaries[i] = upper_bound;
+    rep.lower_boundaries[i] = upper_bound;
     upper_bound *= growth_factor;
   }
-  return BucketBoundaries(std::move(boundaries));
+  if (num_finite_buckets > 1 && scale > 0 && std::isfinite(1 / scale) &&
+      growth_factor > 1 &&
+      1 / std::log2(growth_factor) <= kMaxExponentialInverseStep) {
+    rep.kind = Kind::kExponential;
+    rep.origin = 1 / scale;
+    rep.inverse_step = 1 / std::log2(growth_factor);
+  }
+  return Intern(std::move(rep));
 }
 
 // static
 BucketBoundaries BucketBoundaries::Explicit(std::vector<double> boundaries) {
+  Rep rep;
   if (!std::is_sorted(boundaries.begin(), boundaries.end())) {
     std::cerr << "BucketBoundaries::Explicit called with non-monotonic "
                  "boundary list.\n";
     ABSL_ASSERT(0);
-    return BucketBoundaries({});
+    return Intern(std::move(rep));
   }
-  return BucketBoundaries(std::move(boundaries));
+  rep.lower_boundaries = std::move(boundaries);
+  const int size = rep.lower_boundaries.size();
+  if (size > 0 && size <= kMaxComparedBoundaries) {
+    rep.padded_boundaries = rep.lower_boundaries;
+    rep.padded_boundaries.resize(
+        (size + kChunkSize - 1) / kChunkSize * kChunkSize,
+        std::numeric_limits<double>::infinity());
+  }
+  return Intern(std::move(rep));
+}
+
+constexpr int BucketBoundaries::kMaxLogLinearPrecision;
+
+// static
+BucketBoundaries BucketBoundaries::LogLinear(int precision) {
+  if (precision < 0 || precision > kMaxLogLinearPrecision) {
+    std::cerr << "BucketBoundaries::LogLinear called with precision "
+              << precision << " outside [0, " << kMaxLogLinearPrecision
+              << "].\n";
+    ABSL_ASSERT(0);
+    precision = std::min(std::max(precision, 0), kMaxLogLinearPrecision);
+  }
+  // There are few possible LogLinear boundaries, so they are kept for the
+  // lifetime of the process rather than interned, which also keeps them
+  // distinct from equal Explicit() boundaries, whose Distributions are not
+  // auto-ranging.
+  struct Registry {
+    absl::Mutex mu;
+    std::shared_ptr<const Rep> reps[kMaxLogLinearPrecision + 1] GUARDED_BY(mu);
+  };
+  static Registry* const registry = new Registry;
+  absl::MutexLock l(&registry->mu);
+  std::shared_ptr<const Rep>& shared = registry->reps[precision];
+  if (shared == nullptr) {
+    Rep rep;
+    rep.kind = Kind::kLogLinear;
+    rep.precision = precision;
+    const int sub_buckets = 1 << precision;
+    rep.lower_boundaries.reserve(
+        (kLogLinearMaxExponent - kLogLinearMinExponent) * sub_buckets + 1);
+    for (int exponent = kLogLinearMinExponent;
+         exponent < kLogLinearMaxExponent; ++exponent) {
+      for (int i = 0; i < sub_buckets; ++i) {
+        // Exact, since the mantissa has at most 'precision' bits.
+        rep.lower_boundaries.push_back(
+            std::ldexp(1 + static_cast<double>(i) / sub_buckets, exponent));
+      }
+    }
+    rep.lower_boundaries.push_back(std::ldexp(1.0, kLogLinearMaxExponent));
+    shared = std::make_shared<const Rep>(std::move(rep));
+  }
+  return BucketBoundaries(shared);
+}
+
+// static
+BucketBoundaries BucketBoundaries::Intern(Rep rep) {
+  if (rep.lower_boundaries.empty()) {
+    // Used by every non-distribution Aggregation, so this skips the registry.
+    static const std::shared_ptr<const Rep>* const empty =
+        new std::shared_ptr<const Rep>(std::make_shared<const Rep>());
+    return BucketBoundaries(*empty);
+  }
+  struct Registry {
+    absl::Mutex mu;
+    // Entries expire when the last BucketBoundaries using them is destroyed,
+    // and are swept out whenever the map doubles in size.
+    std::unordered_map<std::vector<double>, std::weak_ptr<const Rep>,
+                       absl::Hash<std::vector<double>>>
+        reps GUARDED_BY(mu);
+    size_t sweep_size GUARDED_BY(mu) = 16;
+  };
+  static Registry* const registry = new Registry;
+  absl::MutexLock l(&registry->mu);
+  std::weak_ptr<const Rep>& entry = registry->reps[rep.lower_boundaries];
+  std::shared_ptr<const Rep> shared = entry.lock();
+  if (shared == nullptr) {
+    shared = std::make_shared<const Rep>(std::move(rep));
+    entry = shared;
+    if (registry->reps.size() >= registry->sweep_size) {
+      for (auto it = registry->reps.begin(); it != registry->reps.end();) {
+        if (it->second.expired()) {
+          it = registry->reps.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      registry->sweep_size = 2 * std::max<size_t>(registry->reps.size(), 8);
+    }
+  }
+  return BucketBoundaries(std::move(shared));
 }
 
 int BucketBoundaries::BucketForValue(double value) const {
-  return std::upper_bound(lower_boundaries_.begin(), lower_boundaries_.end(),
-                          value) -
-         lower_boundaries_.begin();
+  const Rep& rep = *rep_;
+  if (rep.kind == Kind::kLogLinear) {
+    return LogLinearBucket(value);
+  }
+  const std::vector<double>& boundaries = rep.lower_boundaries;
+  if (!rep.padded_boundaries.empty()) {
+    // The padding is counted for infinite and NaN values.
+    return std::min<int>(CountBoundaries(rep.padded_boundaries, value),
+                         boundaries.size());
+  }
+  // NaN compares false with every boundary, so it also takes the search, which
+  // places it in the overflow bucket.
+  const int size = boundaries.size();
+  if (rep.kind == Kind::kExplicit ||
+      !(value >= boundaries[0] && value < boundaries[size - 1])) {
+    return std::upper_bound(boundaries.begin(), boundaries.end(), value) -
+           boundaries.begin();
+  }
+  // The boundaries were accumulated with rounding error, so the estimate may be
+  // off by one near a boundary; correct it against the boundaries themselves.
+  // Since boundaries[0] <= value < boundaries[size - 1], the result is in
+  // [1, size - 1].
+  int bucket = std::min(std::max(EstimateBucket(value), 1), size - 1);
+  while (boundaries[bucket - 1] > value) {
+    --bucket;
+  }
+  while (boundaries[bucket] <= value) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+int BucketBoundaries::EstimateBucket(double value) const {
+  switch (rep_->kind) {
+    case Kind::kLinear:
+      return 1 + static_cast<int>((value - rep_->origin) * rep_->inverse_step);
+    case Kind::kExponential: {
+      // Bucket 1 covers [0, scale); bucket i > 1 covers
+      // [scale * growth_factor ^ (i - 2), scale * growth_factor ^ (i - 1)).
+      const double scaled = value * rep_->origin;
+      if (scaled < 1) {
+        return 1;
+      }
+      return 2 +
+             static_cast<int>(ApproximateLog2(scaled) * rep_->inverse_step);
+    }
+    case Kind::kExplicit:
+    case Kind::kLogLinear:
+      break;
+  }
+  return 0;
+}
+
+int BucketBoundaries::LogLinearBucket(double value) const {
+  const std::vector<double>& boundaries = rep_->lower_boundaries;
+  if (value < boundaries.front()) {
+    return 0;
+  }
+  // Also catches NaN, which goes in the overflow bucket as for other
+  // boundaries.
+  if (!(value < boundaries.back())) {
+    return boundaries.size();
+  }
+  // 'value' is positive and normal, so its bits are the biased exponent
+  // followed by the 52 explicit mantissa bits, of which the top 'precision'
+  // select the bucket within the power of two.
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const int exponent = static_cast<int>(bits >> 52) - 1023;
+  const int precision = rep_->precision;
+  const int sub_bucket =
+      static_cast<int>((bits & ((uint64_t{1} << 52) - 1)) >> (52 - precision));
+  return 1 + ((exponent - kLogLinearMinExponent) << precision) + sub_bucket;
 }
 
 std::string BucketBoundaries::DebugString() const {
-  return absl::StrCat("Buckets: ", absl::StrJoin(lower_boundaries_, ","));
+  if (rep_->kind == Kind::kLogLinear) {
+    return absl::StrCat("Buckets: log-linear, precision ", rep_->precision);
+  }
+  return absl::StrCat("Buckets: ",
+                      absl::StrJoin(rep_->lower_boundaries, ","));
 }
 
 }  // namespace stats
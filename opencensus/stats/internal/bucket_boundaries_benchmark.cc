@@ -0,0 +1,71 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "opencensus/stats/bucket_boundaries.h"
+
+namespace opencensus {
+namespace stats {
+namespace {
+
+// Looks up values spread over the range of 'bucket_boundaries', in an order
+// that the branch predictor cannot learn.
+void BenchmarkBucketForValue(const BucketBoundaries& bucket_boundaries,
+                             benchmark::State& state) {
+  const std::vector<double>& boundaries = bucket_boundaries.lower_boundaries();
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> bucket(0, boundaries.size() - 2);
+  std::uniform_real_distribution<double> fraction(0, 1);
+  std::vector<double> values(1024);
+  for (auto& value : values) {
+    const int i = bucket(gen);
+    value = boundaries[i] + (boundaries[i + 1] - boundaries[i]) * fraction(gen);
+  }
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        bucket_boundaries.BucketForValue(values[i++ & 1023]));
+  }
+}
+
+void BM_BucketForValueLinear(benchmark::State& state) {
+  BenchmarkBucketForValue(BucketBoundaries::Linear(state.range(0), 0, 1),
+                          state);
+}
+BENCHMARK(BM_BucketForValueLinear)->Arg(10)->Arg(100)->Arg(1000);
+
+void BM_BucketForValueExponential(benchmark::State& state) {
+  BenchmarkBucketForValue(
+      BucketBoundaries::Exponential(
+          state.range(0), 1, std::pow(1e6, 1.0 / state.range(0))),
+      state);
+}
+BENCHMARK(BM_BucketForValueExponential)->Arg(10)->Arg(100)->Arg(1000);
+
+void BM_BucketForValueExplicit(benchmark::State& state) {
+  BenchmarkBucketForValue(
+      BucketBoundaries::Explicit(
+          BucketBoundaries::Linear(state.range(0), 0, 1).lower_boundaries()),
+      state);
+}
+BENCHMARK(BM_BucketForValueExplicit)->Arg(10)->Arg(30)->Arg(100)->Arg(1000);
+
+}  // namespace
+}  // namespace stats
+}  // namespace opencensus
+BENCHMARK_MAIN();
@@ -14,6 +14,11 @@
 
 #include "opencensus/stats/bucket_boundaries.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
@@ -61,6 +66,98 @@ TEST(BucketBoundariesTest, BucketForValue) {
   EXPECT_EQ(2, bucket_boundaries.BucketForValue(11));
 }
 
+// Checks that BucketForValue() agrees with a search of the boundaries at, and
+// next to, every boundary and at points between them.
+void ExpectBucketsMatchSearch(const BucketBoundaries& bucket_boundaries) {
+  const std::vector<double>& boundaries = bucket_boundaries.lower_boundaries();
+  std::vector<double> values = {-std::numeric_limits<double>::infinity(),
+                                std::numeric_limits<double>::infinity(),
+                                std::numeric_limits<double>::quiet_NaN()};
+  for (int i = 0; i < boundaries.size(); ++i) {
+    values.push_back(boundaries[i]);
+    values.push_back(std::nextafter(boundaries[i], -HUGE_VAL));
+    values.push_back(std::nextafter(boundaries[i], HUGE_VAL));
+    if (i > 0) {
+      for (int j = 1; j < 8; ++j) {
+        values.push_back(boundaries[i - 1] +
+                         (boundaries[i] - boundaries[i - 1]) * j / 8);
+      }
+    }
+  }
+  for (const double value : values) {
+    EXPECT_EQ(std::upper_bound(boundaries.begin(), boundaries.end(), value) -
+                  boundaries.begin(),
+              bucket_boundaries.BucketForValue(value))
+        << value;
+  }
+}
+
+TEST(BucketBoundariesTest, BucketForValueLinear) {
+  ExpectBucketsMatchSearch(BucketBoundaries::Linear(3, 2, 1.5));
+  ExpectBucketsMatchSearch(BucketBoundaries::Linear(100, -1, 0.1));
+  ExpectBucketsMatchSearch(BucketBoundaries::Linear(1000, 0.3, 0.7));
+  ExpectBucketsMatchSearch(BucketBoundaries::Linear(0, 1, 1));
+}
+
+TEST(BucketBoundariesTest, BucketForValueExponential) {
+  ExpectBucketsMatchSearch(BucketBoundaries::Exponential(3, 1.5, 2));
+  ExpectBucketsMatchSearch(BucketBoundaries::Exponential(100, 0.01, 1.1));
+  ExpectBucketsMatchSearch(BucketBoundaries::Exponential(50, 1e-3, 1.7));
+  ExpectBucketsMatchSearch(BucketBoundaries::Exponential(1, 1, 2));
+  // Growth factors near 1 are searched rather than estimated.
+  ExpectBucketsMatchSearch(BucketBoundaries::Exponential(1000, 1, 1.01));
+  ExpectBucketsMatchSearch(BucketBoundaries::Exponential(100, 1e-3, 1.001));
+}
+
+TEST(BucketBoundariesTest, BucketForValueExplicit) {
+  ExpectBucketsMatchSearch(BucketBoundaries::Explicit({0}));
+  ExpectBucketsMatchSearch(BucketBoundaries::Explicit({-3, -1, 0, 0, 2.5, 7}));
+  std::vector<double> boundaries;
+  for (int i = 0; i < 100; ++i) {
+    boundaries.push_back(i * i);
+    // Lists above and below the size limit for comparing every boundary.
+    ExpectBucketsMatchSearch(BucketBoundaries::Explicit(boundaries));
+  }
+}
+
+TEST(BucketBoundariesTest, LogLinear) {
+  const BucketBoundaries bucket_boundaries = BucketBoundaries::LogLinear(2);
+  EXPECT_TRUE(bucket_boundaries.auto_ranging());
+  EXPECT_FALSE(BucketBoundaries::Explicit({0, 1}).auto_ranging());
+  EXPECT_EQ(bucket_boundaries, BucketBoundaries::LogLinear(2));
+  EXPECT_NE(bucket_boundaries, BucketBoundaries::LogLinear(3));
+  // Equal explicit boundaries are not auto-ranging, so are kept separate.
+  EXPECT_NE(bucket_boundaries,
+            BucketBoundaries::Explicit(bucket_boundaries.lower_boundaries()));
+
+  EXPECT_EQ(64 * 4 + 2, bucket_boundaries.num_buckets());
+  EXPECT_EQ(std::ldexp(1.0, -32), bucket_boundaries.lower_boundaries().front());
+  EXPECT_EQ(std::ldexp(1.0, 32), bucket_boundaries.lower_boundaries().back());
+  EXPECT_EQ(0, bucket_boundaries.BucketForValue(0));
+  EXPECT_EQ(0, bucket_boundaries.BucketForValue(-1));
+  // [1, 1.25) is the first bucket of 2^0.
+  EXPECT_EQ(1 + 32 * 4, bucket_boundaries.BucketForValue(1));
+  EXPECT_EQ(1 + 32 * 4, bucket_boundaries.BucketForValue(1.2));
+  EXPECT_EQ(2 + 32 * 4, bucket_boundaries.BucketForValue(1.25));
+  EXPECT_EQ(5 + 32 * 4, bucket_boundaries.BucketForValue(2));
+}
+
+TEST(BucketBoundariesTest, BucketForValueLogLinear) {
+  for (int precision = 0; precision <= BucketBoundaries::kMaxLogLinearPrecision;
+       ++precision) {
+    ExpectBucketsMatchSearch(BucketBoundaries::LogLinear(precision));
+  }
+}
+
+TEST(BucketBoundariesTest, LogLinearRelativeError) {
+  const int precision = 4;
+  const std::vector<double>& boundaries =
+      BucketBoundaries::LogLinear(precision).lower_boundaries();
+  for (int i = 1; i < boundaries.size(); ++i) {
+    EXPECT_LE(boundaries[i] / boundaries[i - 1], 1 + std::ldexp(1, -precision));
+  }
+}
+
 TEST(BucketBoundariesTest, BucketForValueEmptyBuckets) {
   BucketBoundaries bucket_boundaries = BucketBoundaries::Explicit({});
   EXPECT_EQ(0, bucket_boundaries.BucketForValue(-1000));
@@ -68,6 +165,26 @@ TEST(BucketBoundariesTest, BucketForValueEmptyBuckets) {
   EXPECT_EQ(0, bucket_boundaries.BucketForValue(1000));
 }
 
+TEST(BucketBoundariesTest, EqualBoundariesShareData) {
+  const BucketBoundaries explicit_boundaries =
+      BucketBoundaries::Explicit({0, 1, 2});
+  const BucketBoundaries linear_boundaries = BucketBoundaries::Linear(2, 0, 1);
+  EXPECT_EQ(explicit_boundaries, linear_boundaries);
+  EXPECT_EQ(&explicit_boundaries.lower_boundaries(),
+            &linear_boundaries.lower_boundaries());
+  EXPECT_NE(explicit_boundaries, BucketBoundaries::Explicit({0, 1}));
+  EXPECT_EQ(BucketBoundaries::Explicit({}), BucketBoundaries::Explicit({}));
+}
+
+TEST(BucketBoundariesDeathTest, LogLinearPrecisionOutOfRange) {
+  EXPECT_DEBUG_DEATH(
+      {
+        EXPECT_EQ(BucketBoundaries::LogLinear(0),
+                  BucketBoundaries::LogLinear(-1));
+      },
+      "");
+}
+
 TEST(BucketBoundariesDeathTest, NonMonotonicExplicit) {
   const std::initializer_list<double> boundaries = {0, -1, 1};
   EXPECT_DEBUG_DEATH(
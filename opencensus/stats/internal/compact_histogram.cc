@@ -0,0 +1,266 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "opencensus/stats/internal/compact_histogram.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "absl/base/config.h"
+#include "absl/base/macros.h"
+#include "absl/types/span.h"
+
+namespace opencensus {
+namespace stats {
+
+namespace {
+
+// Sparse entries are scanned linearly, so their number is capped even for
+// histograms with many buckets.
+constexpr size_t kMaxSparseEntries = 16;
+constexpr uint64_t kMaxSparseCount = 0xffffffff;
+
+uint64_t SparseEntry(int bucket, uint64_t count) {
+  return static_cast<uint64_t>(bucket) << 32 | count;
+}
+int SparseBucket(uint64_t entry) { return entry >> 32; }
+uint64_t SparseCount(uint64_t entry) { return entry & kMaxSparseCount; }
+
+uint64_t MaxCount(int width) {
+  return width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+}
+
+// Returns the narrowest counter width that holds 'count'.
+int WidthFor(uint64_t count) {
+  if (count <= MaxCount(8)) return 8;
+  if (count <= MaxCount(16)) return 16;
+  if (count <= MaxCount(32)) return 32;
+  return 64;
+}
+
+#ifdef ABSL_IS_LITTLE_ENDIAN
+// Adds counters [begin, begin + size) of type Counter, packed consecutively
+// from the start of 'words', to 'buckets'. On little-endian machines this is
+// the dense layout, and reading whole counters lets the compiler vectorize the
+// loop.
+template <typename Counter, typename T>
+void AddCounters(const uint64_t* words, int begin, int size, T* buckets) {
+  const char* bytes =
+      reinterpret_cast<const char*>(words) + begin * sizeof(Counter);
+  for (int i = 0; i < size; ++i) {
+    Counter counter;
+    memcpy(&counter, bytes + i * sizeof(Counter), sizeof(Counter));
+    buckets[i] += counter;
+  }
+}
+#endif
+
+}  // namespace
+
+CompactHistogram::CompactHistogram(int num_buckets)
+    : num_buckets_(num_buckets) {}
+
+void CompactHistogram::Add(int bucket, uint64_t count) {
+  ABSL_ASSERT(bucket >= 0 && bucket < num_buckets_);
+  if (width_ == 0) {
+    for (auto& entry : storage_) {
+      if (SparseBucket(entry) == bucket) {
+        const uint64_t new_count = SparseCount(entry) + count;
+        if (new_count <= kMaxSparseCount) {
+          entry += count;
+          return;
+        }
+        Densify(WidthFor(new_count), bucket);
+        AddDense(bucket, count);
+        return;
+      }
+    }
+    // A dense histogram of 8-bit counters takes one word per 8 buckets.
+    const size_t max_sparse_entries =
+        std::min(kMaxSparseEntries, (num_buckets_ + 7) / size_t{8});
+    if (storage_.size() < max_sparse_entries && count <= kMaxSparseCount) {
+      storage_.push_back(SparseEntry(bucket, count));
+      return;
+    }
+    Densify(WidthFor(count), bucket);
+  }
+  AddDense(bucket, count);
+}
+
+void CompactHistogram::Merge(const CompactHistogram& other) {
+  ABSL_ASSERT(num_buckets_ == other.num_buckets_);
+  if (other.width_ == 0) {
+    for (const auto entry : other.storage_) {
+      Add(SparseBucket(entry), SparseCount(entry));
+    }
+  } else {
+    for (int i = other.dense_begin_; i < other.dense_end_; ++i) {
+      const uint64_t count = other.DenseCount(i);
+      if (count != 0) {
+        Add(i, count);
+      }
+    }
+  }
+}
+
+void CompactHistogram::Reset() {
+  storage_.clear();
+  width_ = 0;
+  dense_begin_ = 0;
+  dense_end_ = 0;
+}
+
+uint64_t CompactHistogram::bucket_count(int bucket) const {
+  if (width_ != 0) {
+    return bucket >= dense_begin_ && bucket < dense_end_ ? DenseCount(bucket)
+                                                         : 0;
+  }
+  for (const auto entry : storage_) {
+    if (SparseBucket(entry) == bucket) {
+      return SparseCount(entry);
+    }
+  }
+  return 0;
+}
+
+std::pair<int, int> CompactHistogram::bucket_range() const {
+  if (width_ != 0) {
+    // The dense counters grow ahead of the values, so skip the empty ones at
+    // either end.
+    int begin = dense_begin_;
+    int end = dense_end_;
+    while (begin < end && DenseCount(begin) == 0) ++begin;
+    while (end > begin && DenseCount(end - 1) == 0) --end;
+    return begin == end ? std::make_pair(0, 0) : std::make_pair(begin, end);
+  }
+  if (storage_.empty()) {
+    return std::make_pair(0, 0);
+  }
+  int begin = num_buckets_;
+  int end = 0;
+  for (const auto entry : storage_) {
+    begin = std::min(begin, SparseBucket(entry));
+    end = std::max(end, SparseBucket(entry) + 1);
+  }
+  return std::make_pair(begin, end);
+}
+
+template <typename T>
+void CompactHistogram::AddTo(absl::Span<T> buckets, int first_bucket) const {
+  if (width_ == 0) {
+    for (const auto entry : storage_) {
+      ABSL_ASSERT(SparseBucket(entry) >= first_bucket &&
+                  SparseBucket(entry) - first_bucket < buckets.size());
+      buckets[SparseBucket(entry) - first_bucket] += SparseCount(entry);
+    }
+  } else {
+    // 'buckets' need only cover the populated counters.
+    const std::pair<int, int> range = bucket_range();
+    if (range.first == range.second) {
+      return;
+    }
+    ABSL_ASSERT(range.first >= first_bucket &&
+                range.second - first_bucket <= buckets.size());
+#ifdef ABSL_IS_LITTLE_ENDIAN
+    T* const dense_buckets = buckets.data() + (range.first - first_bucket);
+    const int begin = range.first - dense_begin_;
+    const int size = range.second - range.first;
+    switch (width_) {
+      case 8:
+        AddCounters<uint8_t>(storage_.data(), begin, size, dense_buckets);
+        return;
+      case 16:
+        AddCounters<uint16_t>(storage_.data(), begin, size, dense_buckets);
+        return;
+      case 32:
+        AddCounters<uint32_t>(storage_.data(), begin, size, dense_buckets);
+        return;
+      case 64:
+        AddCounters<uint64_t>(storage_.data(), begin, size, dense_buckets);
+        return;
+    }
+#endif
+    for (int i = range.first; i < range.second; ++i) {
+      buckets[i - first_bucket] += DenseCount(i);
+    }
+  }
+}
+
+template void CompactHistogram::AddTo(absl::Span<uint64_t>, int) const;
+template void CompactHistogram::AddTo(absl::Span<double>, int) const;
+
+void CompactHistogram::Densify(int min_width, int bucket) {
+  const std::pair<int, int> range = bucket_range();
+  int begin = bucket;
+  int end = bucket + 1;
+  if (range.first < range.second) {
+    begin = std::min(begin, range.first);
+    end = std::max(end, range.second);
+  }
+  // Grows the dense range at least geometrically, so that values drifting
+  // outward do not copy the counters on every Add().
+  const int min_size =
+      std::min(num_buckets_, 2 * (dense_end_ - dense_begin_));
+  if (end - begin < min_size) {
+    if (bucket < range.first) {
+      begin = std::max(0, end - min_size);
+      end = begin + min_size;
+    } else {
+      end = std::min(num_buckets_, begin + min_size);
+      begin = end - min_size;
+    }
+  }
+
+  std::vector<uint64_t> counts(end - begin);
+  AddTo(absl::Span<uint64_t>(counts), begin);
+  int width = min_width;
+  for (const auto count : counts) {
+    width = std::max(width, WidthFor(count));
+  }
+  // Reuses the existing allocation if it is large enough.
+  width_ = width;
+  dense_begin_ = begin;
+  dense_end_ = end;
+  storage_.assign(((end - begin) * width_ + 63) / 64, 0);
+  for (int i = 0; i < counts.size(); ++i) {
+    if (counts[i] != 0) {
+      const int bit = i * width_;
+      storage_[bit / 64] |= counts[i] << (bit % 64);
+    }
+  }
+}
+
+uint64_t CompactHistogram::DenseCount(int bucket) const {
+  const int bit = (bucket - dense_begin_) * width_;
+  return (storage_[bit / 64] >> (bit % 64)) & MaxCount(width_);
+}
+
+void CompactHistogram::AddDense(int bucket, uint64_t count) {
+  if (bucket < dense_begin_ || bucket >= dense_end_) {
+    Densify(width_, bucket);
+  }
+  const uint64_t new_count = DenseCount(bucket) + count;
+  ABSL_ASSERT(new_count >= count && "Histogram count overflow.");
+  if (new_count > MaxCount(width_)) {
+    Densify(WidthFor(new_count), bucket);
+  }
+  const int bit = (bucket - dense_begin_) * width_;
+  storage_[bit / 64] += count << (bit % 64);
+}
+
+}  // namespace stats
+}  // namespace opencensus
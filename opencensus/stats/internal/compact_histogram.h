@@ -0,0 +1,96 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OPENCENSUS_STATS_INTERNAL_COMPACT_HISTOGRAM_H_
+#define OPENCENSUS_STATS_INTERNAL_COMPACT_HISTOGRAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+
+namespace opencensus {
+namespace stats {
+
+// CompactHistogram holds the bucket counts of a histogram in little more
+// memory than its populated buckets need. It allocates nothing until the first
+// Add(). While few buckets are populated it stores (bucket, count) pairs; once
+// an array of counters would be no larger, it switches to one, with counters
+// that start 8 bits wide and widen up to 64 bits as counts grow. The array
+// covers only the range of populated buckets, growing as needed.
+//
+// CompactHistogram is thread-compatible.
+class CompactHistogram final {
+ public:
+  explicit CompactHistogram(int num_buckets);
+
+  int num_buckets() const { return num_buckets_; }
+
+  // Adds 'count' to the bucket with index 'bucket'.
+  void Add(int bucket, uint64_t count = 1);
+
+  // Adds the counts in 'other', which must have the same number of buckets.
+  void Merge(const CompactHistogram& other);
+
+  // Zeroes all counts and returns to the sparse representation, keeping the
+  // allocated storage for reuse.
+  void Reset();
+
+  uint64_t bucket_count(int bucket) const;
+
+  // Returns the smallest [begin, end) such that all buckets outside that range
+  // have a count of zero. begin == end if all counts are zero.
+  std::pair<int, int> bucket_range() const;
+
+  // Adds the count of each bucket to element (bucket - first_bucket) of
+  // 'buckets', which must cover bucket_range().
+  template <typename T>
+  void AddTo(absl::Span<T> buckets, int first_bucket = 0) const;
+
+  // Whether the counts are stored as (bucket, count) pairs, and the width in
+  // bits of the counters otherwise. Exposed for testing.
+  bool is_sparse() const { return width_ == 0; }
+  int counter_width() const { return width_; }
+
+ private:
+  // Switches to dense counters at least 'min_width' bits wide and wide enough
+  // for the current counts, covering the populated buckets and 'bucket'.
+  void Densify(int min_width, int bucket);
+
+  uint64_t DenseCount(int bucket) const;
+  void AddDense(int bucket, uint64_t count);
+
+  int num_buckets_;
+  // The width in bits of the dense counters (8, 16, 32 or 64), or 0 while the
+  // histogram is sparse.
+  int width_ = 0;
+  // The buckets covered by the dense counters.
+  int dense_begin_ = 0;
+  int dense_end_ = 0;
+  // While sparse, one word per populated bucket holding the bucket index in
+  // the high 32 bits and its count in the low 32 bits. Otherwise a counter of
+  // width_ bits for each bucket in [dense_begin_, dense_end_), packed into
+  // words so that none spans two words.
+  std::vector<uint64_t> storage_;
+};
+
+extern template void CompactHistogram::AddTo(absl::Span<uint64_t>, int) const;
+extern template void CompactHistogram::AddTo(absl::Span<double>, int) const;
+
+}  // namespace stats
+}  // namespace opencensus
+
+#endif  // OPENCENSUS_STATS_INTERNAL_COMPACT_HISTOGRAM_H_
@@ -0,0 +1,177 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "opencensus/stats/internal/compact_histogram.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace opencensus {
+namespace stats {
+namespace {
+
+std::vector<uint64_t> Buckets(const CompactHistogram& histogram) {
+  std::vector<uint64_t> buckets(histogram.num_buckets());
+  histogram.AddTo(absl::Span<uint64_t>(buckets));
+  return buckets;
+}
+
+TEST(CompactHistogramTest, SparseUntilDenseIsSmaller) {
+  // 64 buckets take one word per populated bucket while sparse, and 8 words
+  // with 8-bit counters.
+  CompactHistogram histogram(64);
+  EXPECT_TRUE(histogram.is_sparse());
+  for (int i = 0; i < 8; ++i) {
+    histogram.Add(i * 8);
+    EXPECT_TRUE(histogram.is_sparse());
+  }
+  histogram.Add(1);
+  EXPECT_FALSE(histogram.is_sparse());
+  EXPECT_EQ(8, histogram.counter_width());
+  for (int i = 0; i < 64; ++i) {
+    EXPECT_EQ(i % 8 == 0 || i == 1 ? 1 : 0, histogram.bucket_count(i));
+  }
+}
+
+TEST(CompactHistogramTest, CountersWiden) {
+  CompactHistogram histogram(16);
+  histogram.Add(0);
+  histogram.Add(1);
+  histogram.Add(15);
+  ASSERT_FALSE(histogram.is_sparse());
+  EXPECT_EQ(8, histogram.counter_width());
+  histogram.Add(1, 255);
+  EXPECT_EQ(16, histogram.counter_width());
+  histogram.Add(1, 0xffff);
+  EXPECT_EQ(32, histogram.counter_width());
+  histogram.Add(15, 0xffffffff);
+  EXPECT_EQ(64, histogram.counter_width());
+
+  std::vector<uint64_t> expected(16);
+  expected[0] = 1;
+  expected[1] = 1 + 255 + 0xffff;
+  expected[15] = 1 + 0xffffffffull;
+  EXPECT_EQ(expected, Buckets(histogram));
+}
+
+TEST(CompactHistogramTest, LargeSparseCount) {
+  CompactHistogram histogram(64);
+  histogram.Add(3, 0xffffffff);
+  EXPECT_TRUE(histogram.is_sparse());
+  histogram.Add(3);
+  EXPECT_FALSE(histogram.is_sparse());
+  EXPECT_EQ(64, histogram.counter_width());
+  EXPECT_EQ(0x100000000ull, histogram.bucket_count(3));
+}
+
+TEST(CompactHistogramTest, Merge) {
+  CompactHistogram sparse(64);
+  sparse.Add(1, 2);
+  sparse.Add(63);
+  CompactHistogram dense(64);
+  for (int i = 0; i < 64; ++i) {
+    dense.Add(i, i);
+  }
+  ASSERT_FALSE(dense.is_sparse());
+
+  CompactHistogram histogram(64);
+  histogram.Merge(sparse);
+  EXPECT_TRUE(histogram.is_sparse());
+  histogram.Merge(dense);
+  std::vector<uint64_t> expected(64);
+  for (int i = 0; i < 64; ++i) {
+    expected[i] = i;
+  }
+  expected[1] += 2;
+  expected[63] += 1;
+  EXPECT_EQ(expected, Buckets(histogram));
+}
+
+TEST(CompactHistogramTest, Reset) {
+  CompactHistogram histogram(8);
+  histogram.Add(0, 1000);
+  histogram.Add(7);
+  histogram.Reset();
+  EXPECT_TRUE(histogram.is_sparse());
+  EXPECT_THAT(Buckets(histogram), ::testing::Each(0));
+  histogram.Add(4);
+  EXPECT_EQ(1, histogram.bucket_count(4));
+  EXPECT_EQ(0, histogram.bucket_count(0));
+}
+
+TEST(CompactHistogramTest, DenseCountersCoverPopulatedRange) {
+  CompactHistogram histogram(1000);
+  EXPECT_EQ(std::make_pair(0, 0), histogram.bucket_range());
+  histogram.Add(510);
+  histogram.Add(500);
+  EXPECT_EQ(std::make_pair(500, 511), histogram.bucket_range());
+  // The 17th populated bucket switches to dense counters.
+  for (int i = 0; i < 17; ++i) {
+    histogram.Add(500 + i);
+  }
+  ASSERT_FALSE(histogram.is_sparse());
+  EXPECT_EQ(std::make_pair(500, 517), histogram.bucket_range());
+
+  // The range grows to take in new buckets, without losing counts. It stays
+  // exact although the counters grow ahead of it.
+  histogram.Add(520, 300);
+  EXPECT_EQ(std::make_pair(500, 521), histogram.bucket_range());
+  EXPECT_EQ(16, histogram.counter_width());
+  histogram.Add(5);
+  EXPECT_EQ(std::make_pair(5, 521), histogram.bucket_range());
+  EXPECT_EQ(2, histogram.bucket_count(500));
+  EXPECT_EQ(2, histogram.bucket_count(510));
+  EXPECT_EQ(300, histogram.bucket_count(520));
+  EXPECT_EQ(1, histogram.bucket_count(5));
+  EXPECT_EQ(0, histogram.bucket_count(999));
+
+  std::vector<uint64_t> buckets(histogram.bucket_range().second -
+                                histogram.bucket_range().first);
+  histogram.AddTo(absl::Span<uint64_t>(buckets),
+                  histogram.bucket_range().first);
+  EXPECT_EQ(1, buckets[0]);
+  EXPECT_EQ(300, buckets[520 - 5]);
+}
+
+TEST(CompactHistogramTest, AddToWithEachCounterWidth) {
+  for (const uint64_t count : {uint64_t{1}, uint64_t{1000}, uint64_t{100000},
+                               uint64_t{10000000000}}) {
+    // Enough buckets to populate several words, at an offset.
+    CompactHistogram histogram(100);
+    std::vector<uint64_t> expected(100);
+    for (int i = 10; i < 90; i += 3) {
+      histogram.Add(i, count + i);
+      expected[i] = count + i;
+    }
+    ASSERT_FALSE(histogram.is_sparse());
+    EXPECT_EQ(expected, Buckets(histogram)) << histogram.counter_width();
+  }
+}
+
+TEST(CompactHistogramTest, AddToDouble) {
+  CompactHistogram histogram(4);
+  histogram.Add(2, 3);
+  std::vector<double> buckets = {1, 1, 1, 1};
+  histogram.AddTo(absl::Span<double>(buckets));
+  EXPECT_THAT(buckets, ::testing::ElementsAre(1, 1, 4, 1));
+}
+
+}  // namespace
+}  // namespace stats
+}  // namespace opencensus
@@ -36,6 +36,14 @@ TEST(DebugStringTest, Aggregation) {
   const BucketBoundaries buckets = BucketBoundaries::Explicit({0, 1});
   EXPECT_PRED_FORMAT2(::testing::IsSubstring, buckets.DebugString(),
                       Aggregation::Distribution(buckets).DebugString());
+  const Aggregation sketch = Aggregation::QuantileSketch(3, 100);
+  EXPECT_PRED_FORMAT2(::testing::IsSubstring,
+                      sketch.bucket_boundaries().DebugString(),
+                      sketch.DebugString());
+  EXPECT_NE(sketch.DebugString(),
+            Aggregation::LogLinearHistogram(3).DebugString());
+  EXPECT_NE(sketch.DebugString(),
+            Aggregation::QuantileSketch(3, 100, {0.5}).DebugString());
 }
 
 TEST(DebugStringTest, AggregationWindow) {
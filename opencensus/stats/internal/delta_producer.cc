@@ -15,59 +15,326 @@
 #include "opencensus/stats/internal/delta_producer.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <iostream>
+#include <iterator>
 #include <memory>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "opencensus/stats/aggregation.h"
 #include "opencensus/stats/bucket_boundaries.h"
+#include "opencensus/stats/internal/compact_histogram.h"
 #include "opencensus/stats/internal/measure_data.h"
 #include "opencensus/stats/internal/measure_registry_impl.h"
 #include "opencensus/stats/internal/stats_manager.h"
+#include "opencensus/tags/tag_key.h"
+
+#if defined(_MSC_VER)
+#define TLS __declspec(thread)
+#else
+#define TLS __thread
+#endif
 
 namespace opencensus {
 namespace stats {
 
-void Delta::Record(std::initializer_list<Measurement> measurements,
-                   opencensus::tags::TagMap tags) {
-  auto it = delta_.find(tags);
-  if (it == delta_.end()) {
-    it = delta_.emplace_hint(it, std::piecewise_construct,
-                             std::make_tuple(std::move(tags)),
-                             std::make_tuple(std::vector<MeasureData>()));
-    it->second.reserve(registered_boundaries_.size());
-    for (const auto& boundaries_for_measure : registered_boundaries_) {
-      it->second.emplace_back(boundaries_for_measure);
+namespace {
+
+// The maximum number of shards of the active delta. Each shard holds its own
+// copy of every tagset recorded on it, so more shards trade memory for less
+// contention.
+constexpr int kMaxShards = 64;
+
+// The number of records the queue holds in kQueued mode, and how often the
+// harvester drains it. Together these bound the sustained record rate before
+// the overflow policy applies (here ~800k records/s).
+constexpr size_t kRecordQueueCapacity = 8192;
+constexpr absl::Duration kRecordQueueDrainInterval = absl::Milliseconds(10);
+
+int NumShards() {
+  const int num_cpus = std::thread::hardware_concurrency();
+  return std::max(1, std::min(num_cpus, kMaxShards));
+}
+
+// The shard index assigned to each thread, plus one so that zero means
+// unassigned.
+TLS int thread_shard_index = 0;
+std::atomic<int> next_shard_index(0);
+
+// Returns the index, in [0, NumShards()), of the delta shard and bound measure
+// cell shard assigned to the calling thread.
+int ShardIndexForCurrentThread() {
+  if (thread_shard_index == 0) {
+    // Assign shards round-robin, so that the first NumShards() recording
+    // threads never share a shard.
+    thread_shard_index =
+        next_shard_index.fetch_add(1, std::memory_order_relaxed) %
+            NumShards() +
+        1;
+  }
+  return thread_shard_index - 1;
+}
+
+// Returns the statistics for the measure with index 'measure_index' given
+// 'registered_statistics'.
+MeasureData::Statistics StatisticsForMeasure(
+    const std::vector<MeasureData::Statistics>& registered_statistics,
+    uint64_t measure_index) {
+  return measure_index < registered_statistics.size()
+             ? registered_statistics[measure_index]
+             : MeasureData::Statistics::kAll;
+}
+
+// Returns the estimated memory used by a delta row entry for each measure,
+// given 'registered_boundaries' and 'registered_statistics'.
+std::vector<size_t> EntryBytes(
+    const std::vector<std::vector<BucketBoundaries>>& registered_boundaries,
+    const std::vector<MeasureData::Statistics>& registered_statistics) {
+  std::vector<size_t> entry_bytes;
+  entry_bytes.reserve(registered_boundaries.size());
+  for (uint64_t i = 0; i < registered_boundaries.size(); ++i) {
+    size_t bytes = sizeof(DeltaTable::Entry);
+    if (StatisticsForMeasure(registered_statistics, i) !=
+        MeasureData::Statistics::kAll) {
+      // Only histograms take more memory.
+      entry_bytes.push_back(bytes);
+      continue;
+    }
+    for (const auto& boundaries : registered_boundaries[i]) {
+      // Assumes 8-bit counters, which a histogram outgrows only after more
+      // than 255 values in one bucket.
+      bytes += sizeof(CompactHistogram) + boundaries.num_buckets();
     }
+    entry_bytes.push_back(bytes);
+  }
+  return entry_bytes;
+}
+
+// Returns the estimated memory used by the key for 'tags' in a delta.
+size_t TagsBytes(const opencensus::tags::TagMap& tags) {
+  size_t bytes = sizeof(opencensus::tags::TagMap);
+  for (const auto& tag : tags.tags()) {
+    bytes += sizeof(tag) + tag.second.size();
+  }
+  return bytes;
+}
+
+constexpr size_t kProjectionCacheSize = 16;
+
+// Returns 'tags' restricted to the keys in 'columns', which must be sorted.
+opencensus::tags::TagMap RestrictTags(
+    const opencensus::tags::TagMap& tags,
+    const std::vector<opencensus::tags::TagKey>& columns) {
+  auto is_column =
+      [&columns](const std::pair<opencensus::tags::TagKey, std::string>& tag) {
+        return std::binary_search(columns.begin(), columns.end(), tag.first);
+      };
+  if (std::all_of(tags.tags().begin(), tags.tags().end(), is_column)) {
+    return tags;
   }
+  std::vector<std::pair<opencensus::tags::TagKey, std::string>> kept;
+  std::copy_if(tags.tags().begin(), tags.tags().end(),
+               std::back_inserter(kept), is_column);
+  return opencensus::tags::TagMap(std::move(kept));
+}
+
+}  // namespace
+
+void Delta::Record(absl::Span<const Measurement> measurements,
+                   const opencensus::tags::TagMap& tags) {
+  DeltaTable::Row* row = nullptr;
+  // The columns 'row' was looked up with. Measures recorded together usually
+  // have the same columns and so share a row.
+  const std::vector<opencensus::tags::TagKey>* row_columns = nullptr;
   for (const auto& measurement : measurements) {
     const uint64_t index = MeasureRegistryImpl::IdToIndex(measurement.id_);
     ABSL_ASSERT(index < registered_boundaries_.size());
+    if (index < measure_has_consumers_.size() &&
+        !measure_has_consumers_[index]) {
+      continue;
+    }
+    const std::vector<opencensus::tags::TagKey>* columns =
+        index < measure_columns_.size() ? &measure_columns_[index] : nullptr;
+    if (row == nullptr ||
+        (columns != row_columns &&
+         (columns == nullptr || row_columns == nullptr ||
+          *columns != *row_columns))) {
+      row = &FindOrCreate(columns == nullptr ? tags : ProjectTags(index, tags));
+      row_columns = columns;
+    }
+    MeasureData& data = FindOrCreateData(row, index);
     switch (MeasureRegistryImpl::IdToType(measurement.id_)) {
       case MeasureDescriptor::Type::kDouble:
-        it->second[index].Add(measurement.value_double_);
+        data.Add(measurement.value_double_);
         break;
       case MeasureDescriptor::Type::kInt64:
-        it->second[index].Add(measurement.value_int_);
+        data.Add(measurement.value_int_);
         break;
     }
   }
 }
 
+void Delta::RecordBatch(uint64_t measure_index,
+                        absl::Span<const double> values,
+                        const opencensus::tags::TagMap& tags) {
+  ABSL_ASSERT(measure_index < registered_boundaries_.size());
+  if (values.empty() || (measure_index < measure_has_consumers_.size() &&
+                         !measure_has_consumers_[measure_index])) {
+    return;
+  }
+  DeltaTable::Row& row = FindOrCreate(
+      measure_index < measure_columns_.size() ? ProjectTags(measure_index, tags)
+                                              : tags);
+  FindOrCreateData(&row, measure_index).AddBatch(values);
+}
+
+void Delta::AddMeasureData(uint64_t measure_index,
+                           const opencensus::tags::TagMap& tags,
+                           const MeasureData& data) {
+  ABSL_ASSERT(measure_index < registered_boundaries_.size());
+  if (measure_index < measure_has_consumers_.size() &&
+      !measure_has_consumers_[measure_index]) {
+    return;
+  }
+  DeltaTable::Row& row = FindOrCreate(
+      measure_index < measure_columns_.size() ? ProjectTags(measure_index, tags)
+                                              : tags);
+  FindOrCreateData(&row, measure_index).Merge(data);
+}
+
+void Delta::CopyConsumerConfiguration(const Delta& other) {
+  measure_has_consumers_ = other.measure_has_consumers_;
+  measure_columns_ = other.measure_columns_;
+  projection_cache_.clear();
+}
+
+const opencensus::tags::TagMap& Delta::ProjectTags(
+    uint64_t measure_index, const opencensus::tags::TagMap& tags) {
+  if (projection_cache_.empty()) {
+    projection_cache_.resize(kProjectionCacheSize);
+  }
+  auto& cached =
+      projection_cache_[(opencensus::tags::TagMap::Hash()(tags) ^
+                         measure_index) %
+                        kProjectionCacheSize];
+  if (!cached.has_value() || cached->measure_index != measure_index ||
+      cached->tags != tags) {
+    cached.emplace(CachedProjection{
+        measure_index, tags,
+        RestrictTags(tags, measure_columns_[measure_index])});
+  }
+  return cached->projected;
+}
+
+DeltaTable::Row& Delta::FindOrCreate(const opencensus::tags::TagMap& tags) {
+  bool inserted;
+  DeltaTable::Row& row = delta_.FindOrInsert(tags, &inserted);
+  if (inserted) {
+    approximate_bytes_ += sizeof(DeltaTable::Row) + TagsBytes(tags);
+    // A recycled row keeps the entries of its previous tags, so that their
+    // histograms can be reused. Entries left empty are skipped when merging.
+    for (auto& entry : row) {
+      entry.data.Reset();
+      approximate_bytes_ += entry_bytes_[entry.measure_index];
+    }
+  }
+  return row;
+}
+
+MeasureData& Delta::FindOrCreateData(DeltaTable::Row* row,
+                                     uint64_t measure_index) {
+  DeltaTable::Entry* entry = DeltaTable::FindEntry(row, measure_index);
+  if (entry != nullptr) {
+    return entry->data;
+  }
+  row->push_back(DeltaTable::Entry{
+      measure_index, MeasureData(registered_boundaries_[measure_index],
+                                 StatisticsForMeasure(registered_statistics_,
+                                                      measure_index))});
+  approximate_bytes_ += entry_bytes_[measure_index];
+  return row->back().data;
+}
+
 void Delta::clear() {
-  registered_boundaries_.clear();
   delta_.clear();
+  approximate_bytes_ = 0;
 }
 
 void Delta::SwapAndReset(
-    std::vector<std::vector<BucketBoundaries>>& registered_boundaries,
-    Delta* other) {
+    const std::vector<std::vector<BucketBoundaries>>& registered_boundaries,
+    Delta* other,
+    const std::vector<MeasureData::Statistics>& registered_statistics) {
   registered_boundaries_.swap(other->registered_boundaries_);
-  delta_.swap(other->delta_);
-  delta_.clear();
-  registered_boundaries_ = registered_boundaries;
+  registered_statistics_.swap(other->registered_statistics_);
+  std::swap(delta_, other->delta_);
+  entry_bytes_.swap(other->entry_bytes_);
+  std::swap(approximate_bytes_, other->approximate_bytes_);
+  clear();
+  if (registered_boundaries_ != registered_boundaries ||
+      registered_statistics_ != registered_statistics) {
+    // Pooled rows refer to the old registered_boundaries_, and maintain the
+    // old registered_statistics_.
+    delta_.ClearPool();
+    registered_boundaries_ = registered_boundaries;
+    registered_statistics_ = registered_statistics;
+    entry_bytes_ = EntryBytes(registered_boundaries_, registered_statistics_);
+  }
+}
+
+BoundMeasureCell::BoundMeasureCell(
+    uint64_t measure_index, opencensus::tags::TagMap tags,
+    const std::vector<BucketBoundaries>& boundaries,
+    MeasureData::Statistics statistics)
+    : measure_index_(measure_index),
+      tags_(std::move(tags)),
+      shards_([] {
+        std::vector<std::unique_ptr<Shard>> shards(NumShards());
+        for (auto& shard : shards) {
+          shard.reset(new Shard);
+        }
+        return shards;
+      }()),
+      boundaries_(boundaries) {
+  for (auto& shard : shards_) {
+    absl::MutexLock l(&shard->mu);
+    shard->data.emplace(boundaries_, statistics);
+  }
+}
+
+void BoundMeasureCell::Add(double value) {
+  Shard* shard = shards_[ShardIndexForCurrentThread()].get();
+  absl::MutexLock l(&shard->mu);
+  shard->data->Add(value);
+}
+
+void BoundMeasureCell::HarvestInto(
+    Delta* delta, const std::vector<BucketBoundaries>& boundaries,
+    MeasureData::Statistics statistics) {
+  // boundaries_ may only change while no shard's data refers to it.
+  for (auto& shard : shards_) {
+    shard->mu.Lock();
+  }
+  for (auto& shard : shards_) {
+    if (shard->data->count() != 0) {
+      delta->AddMeasureData(measure_index_, tags_, *shard->data);
+    }
+    // Reset the data before boundaries_, which it refers to.
+    shard->data.reset();
+  }
+  boundaries_ = boundaries;
+  for (auto it = shards_.rbegin(); it != shards_.rend(); ++it) {
+    (*it)->data.emplace(boundaries_, statistics);
+    (*it)->mu.Unlock();
+  }
 }
 
 DeltaProducer* DeltaProducer::Get() {
@@ -79,6 +346,18 @@ void DeltaProducer::AddMeasure() {
   delta_mu_.Lock();
   absl::MutexLock harvester_lock(&harvester_mu_);
   registered_boundaries_.push_back({});
+  // Until a view is added, records are dropped anyway.
+  registered_statistics_.push_back(MeasureData::Statistics::kCount);
+  {
+    absl::MutexLock consumers_lock(&consumers_mu_);
+    if (measure_has_consumers_.size() < registered_boundaries_.size()) {
+      measure_has_consumers_.resize(registered_boundaries_.size(), false);
+      for (auto& shard : shards_) {
+        absl::MutexLock l(&shard->mu);
+        shard->delta.set_measure_has_consumers(measure_has_consumers_);
+      }
+    }
+  }
   SwapDeltas();
   delta_mu_.Unlock();
   ConsumeLastDelta();
@@ -100,42 +379,398 @@ void DeltaProducer::AddBoundaries(uint64_t index,
   }
 }
 
-void DeltaProducer::Record(std::initializer_list<Measurement> measurements,
-                           opencensus::tags::TagMap tags) {
+void DeltaProducer::SetMeasureHasConsumers(uint64_t measure_index,
+                                           bool has_consumers) {
+  absl::MutexLock l(&consumers_mu_);
+  if (measure_index >= measure_has_consumers_.size()) {
+    measure_has_consumers_.resize(measure_index + 1, false);
+  }
+  measure_has_consumers_[measure_index] = has_consumers;
+  for (auto& shard : shards_) {
+    absl::MutexLock shard_lock(&shard->mu);
+    shard->delta.set_measure_has_consumers(measure_has_consumers_);
+  }
+}
+
+void DeltaProducer::AddViewColumns(
+    uint64_t measure_index,
+    const std::vector<opencensus::tags::TagKey>& columns) {
+  delta_mu_.Lock();
+  // Queued records predate the view, so they are aggregated with the old
+  // configuration and flushed to the old views only.
+  DrainRecordQueue();
+  if (measure_index >= column_counts_.size()) {
+    column_counts_.resize(measure_index + 1);
+  }
+  bool added = false;
+  for (const auto& column : columns) {
+    added |= column_counts_[measure_index][column]++ == 0;
+  }
+  if (!added) {
+    delta_mu_.Unlock();
+    return;
+  }
+  absl::MutexLock harvester_lock(&harvester_mu_);
+  UpdateMeasureColumns();
+  SwapDeltas();
+  delta_mu_.Unlock();
+  ConsumeLastDelta();
+}
+
+void DeltaProducer::RemoveViewColumns(
+    uint64_t measure_index,
+    const std::vector<opencensus::tags::TagKey>& columns) {
   absl::MutexLock l(&delta_mu_);
-  active_delta_.Record(measurements, std::move(tags));
+  ABSL_ASSERT(measure_index < column_counts_.size());
+  auto& counts = column_counts_[measure_index];
+  bool removed = false;
+  for (const auto& column : columns) {
+    auto it = counts.find(column);
+    ABSL_ASSERT(it != counts.end());
+    if (--it->second == 0) {
+      counts.erase(it);
+      removed = true;
+    }
+  }
+  // Rows recorded with the removed columns remain valid for the other views,
+  // so the active delta need not be flushed.
+  if (removed) {
+    UpdateMeasureColumns();
+  }
 }
 
-void DeltaProducer::Flush() {
+void DeltaProducer::AddViewAggregation(uint64_t measure_index,
+                                       Aggregation::Type type) {
   delta_mu_.Lock();
+  // As in AddViewColumns().
+  DrainRecordQueue();
+  if (measure_index >= aggregation_counts_.size()) {
+    aggregation_counts_.resize(measure_index + 1);
+  }
+  ++aggregation_counts_[measure_index][type];
+  if (!UpdateMeasureStatistics(measure_index)) {
+    delta_mu_.Unlock();
+    return;
+  }
   absl::MutexLock harvester_lock(&harvester_mu_);
   SwapDeltas();
   delta_mu_.Unlock();
   ConsumeLastDelta();
 }
 
+void DeltaProducer::RemoveViewAggregation(uint64_t measure_index,
+                                          Aggregation::Type type) {
+  absl::MutexLock l(&delta_mu_);
+  ABSL_ASSERT(measure_index < aggregation_counts_.size());
+  auto& counts = aggregation_counts_[measure_index];
+  auto it = counts.find(type);
+  ABSL_ASSERT(it != counts.end());
+  if (--it->second == 0) {
+    counts.erase(it);
+    // Data with more statistics than needed remains valid for the other
+    // views, so the narrower statistics wait for the next flush.
+    UpdateMeasureStatistics(measure_index);
+  }
+}
+
+bool DeltaProducer::UpdateMeasureStatistics(uint64_t measure_index) {
+  ABSL_ASSERT(measure_index < registered_statistics_.size());
+  MeasureData::Statistics statistics = MeasureData::Statistics::kCount;
+  for (const auto& count : aggregation_counts_[measure_index]) {
+    statistics =
+        MeasureData::Union(statistics, MeasureData::StatisticsFor(count.first));
+  }
+  if (statistics == registered_statistics_[measure_index]) {
+    return false;
+  }
+  registered_statistics_[measure_index] = statistics;
+  return true;
+}
+
+std::shared_ptr<BoundMeasureCell> DeltaProducer::AddBoundMeasureCell(
+    uint64_t measure_index, opencensus::tags::TagMap tags) {
+  absl::MutexLock l(&delta_mu_);
+  ABSL_ASSERT(measure_index < registered_boundaries_.size());
+  bound_measure_cells_.push_back(std::make_shared<BoundMeasureCell>(
+      measure_index, std::move(tags), registered_boundaries_[measure_index],
+      active_statistics_[measure_index]));
+  return bound_measure_cells_.back();
+}
+
+void DeltaProducer::SetRecordMode(RecordMode mode,
+                                  OverflowPolicy overflow_policy) {
+  absl::MutexLock l(&delta_mu_);
+  if (mode == RecordMode::kQueued &&
+      record_queue_.load(std::memory_order_relaxed) == nullptr) {
+    record_queue_.store(new RecordQueue(kRecordQueueCapacity),
+                        std::memory_order_release);
+  }
+  overflow_policy_.store(overflow_policy, std::memory_order_relaxed);
+  record_mode_.store(mode, std::memory_order_release);
+}
+
+void DeltaProducer::Record(std::initializer_list<Measurement> measurements,
+                           const opencensus::tags::TagMap& tags) {
+  if (record_mode_.load(std::memory_order_acquire) == RecordMode::kQueued &&
+      measurements.size() <= RecordQueue::kMaxMeasurements) {
+    if (record_queue_.load(std::memory_order_acquire)
+            ->Push(measurements, tags)) {
+      return;
+    }
+    if (overflow_policy_.load(std::memory_order_relaxed) ==
+        OverflowPolicy::kDrop) {
+      dropped_records_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+  DeltaShard* shard = ShardForCurrentThread();
+  size_t new_entries;
+  size_t new_bytes;
+  {
+    absl::MutexLock l(&shard->mu);
+    const size_t old_entries = shard->delta.delta().size();
+    const size_t old_bytes = shard->delta.approximate_bytes();
+    shard->delta.Record(measurements, tags);
+    new_entries = shard->delta.delta().size() - old_entries;
+    new_bytes = shard->delta.approximate_bytes() - old_bytes;
+  }
+  if (new_bytes != 0) {
+    AddActiveUsage(new_entries, new_bytes);
+  }
+}
+
+void DeltaProducer::RecordBatch(uint64_t measure_index,
+                                absl::Span<const double> values,
+                                const opencensus::tags::TagMap& tags) {
+  // Batches are too large for the record queue, and aggregating them in place
+  // is cheap per value.
+  DeltaShard* shard = ShardForCurrentThread();
+  size_t new_entries;
+  size_t new_bytes;
+  {
+    absl::MutexLock l(&shard->mu);
+    const size_t old_entries = shard->delta.delta().size();
+    const size_t old_bytes = shard->delta.approximate_bytes();
+    shard->delta.RecordBatch(measure_index, values, tags);
+    new_entries = shard->delta.delta().size() - old_entries;
+    new_bytes = shard->delta.approximate_bytes() - old_bytes;
+  }
+  if (new_bytes != 0) {
+    AddActiveUsage(new_entries, new_bytes);
+  }
+}
+
+void DeltaProducer::Flush() { FlushForReason(FlushReason::kExplicit); }
+
+void DeltaProducer::SetHarvestOptions(const HarvestOptions& options) {
+  if (options.harvest_interval <= absl::ZeroDuration()) {
+    std::cerr << "Harvest interval must be positive.\n";
+    return;
+  }
+  absl::MutexLock l(&harvest_options_mu_);
+  harvest_options_ = options;
+  effective_harvest_interval_ = options.harvest_interval;
+  max_shard_entries_.store(options.max_shard_entries,
+                           std::memory_order_relaxed);
+  max_bytes_.store(options.max_bytes, std::memory_order_relaxed);
+  // Wake up the harvester to reschedule the next harvest.
+  harvester_wakeup_ = true;
+}
+
+absl::Duration DeltaProducer::harvest_interval() const {
+  absl::MutexLock l(&harvest_options_mu_);
+  return effective_harvest_interval_;
+}
+
 DeltaProducer::DeltaProducer()
-    : harvester_thread_(&DeltaProducer::RunHarvesterLoop, this) {}
+    : shards_([] {
+        std::vector<std::unique_ptr<DeltaShard>> shards(NumShards());
+        for (auto& shard : shards) {
+          shard.reset(new DeltaShard);
+        }
+        return shards;
+      }()),
+      last_deltas_(shards_.size()),
+      harvester_thread_(&DeltaProducer::RunHarvesterLoop, this) {}
+
+DeltaProducer::DeltaShard* DeltaProducer::ShardForCurrentThread() {
+  return shards_[ShardIndexForCurrentThread()].get();
+}
+
+void DeltaProducer::DrainRecordQueue() {
+  RecordQueue* queue = record_queue_.load(std::memory_order_acquire);
+  if (queue == nullptr) {
+    return;
+  }
+  DeltaShard* shard = shards_[0].get();
+  size_t new_entries;
+  size_t new_bytes;
+  {
+    absl::MutexLock l(&shard->mu);
+    const size_t old_entries = shard->delta.delta().size();
+    const size_t old_bytes = shard->delta.approximate_bytes();
+    queue->DrainInto(&shard->delta);
+    new_entries = shard->delta.delta().size() - old_entries;
+    new_bytes = shard->delta.approximate_bytes() - old_bytes;
+  }
+  if (new_bytes != 0) {
+    AddActiveUsage(new_entries, new_bytes);
+  }
+}
+
+void DeltaProducer::AddActiveUsage(size_t entries, size_t bytes) {
+  const size_t total_entries =
+      active_entries_.fetch_add(entries, std::memory_order_relaxed) + entries;
+  const size_t total_bytes =
+      active_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  const size_t max_shard_entries =
+      max_shard_entries_.load(std::memory_order_relaxed);
+  const size_t max_bytes = max_bytes_.load(std::memory_order_relaxed);
+  FlushReason reason;
+  if (max_shard_entries != 0 && total_entries >= max_shard_entries) {
+    reason = FlushReason::kEntryLimit;
+  } else if (max_bytes != 0 && total_bytes >= max_bytes) {
+    reason = FlushReason::kByteLimit;
+  } else {
+    return;
+  }
+  if (early_flush_requested_.exchange(true, std::memory_order_relaxed)) {
+    return;
+  }
+  absl::MutexLock l(&harvest_options_mu_);
+  early_flush_reason_ = reason;
+  harvester_wakeup_ = true;
+}
+
+size_t DeltaProducer::FlushForReason(FlushReason reason) {
+  delta_mu_.Lock();
+  absl::MutexLock harvester_lock(&harvester_mu_);
+  DrainRecordQueue();
+  SwapDeltas();
+  delta_mu_.Unlock();
+  size_t num_entries = 0;
+  for (const auto& last_delta : last_deltas_) {
+    num_entries += last_delta.delta().size();
+  }
+  ConsumeLastDelta();
+  num_flushes_[static_cast<int>(reason)].fetch_add(1,
+                                                   std::memory_order_relaxed);
+  return num_entries;
+}
 
 void DeltaProducer::SwapDeltas() {
-  ABSL_ASSERT(last_delta_.delta().empty() && "Last delta was not consumed.");
-  active_delta_.SwapAndReset(registered_boundaries_, &last_delta_);
+  for (int i = 0; i < shards_.size(); ++i) {
+    ABSL_ASSERT(last_deltas_[i].delta().empty() &&
+                "Last delta was not consumed.");
+    absl::MutexLock l(&shards_[i]->mu);
+    shards_[i]->delta.SwapAndReset(registered_boundaries_, &last_deltas_[i],
+                                   registered_statistics_);
+  }
+  active_statistics_ = registered_statistics_;
+  // Records racing with the swap may be counted against the wrong delta; the
+  // limits are approximate anyway.
+  active_entries_.store(0, std::memory_order_relaxed);
+  active_bytes_.store(0, std::memory_order_relaxed);
+  {
+    // Any pending early flush request is satisfied by this swap.
+    absl::MutexLock l(&harvest_options_mu_);
+    early_flush_reason_.reset();
+  }
+  early_flush_requested_.store(false, std::memory_order_relaxed);
+  // The cells were recorded with the same configuration as the shards, which
+  // is now that of last_deltas_. The consumer configuration stays with the
+  // shards, so it is copied for projecting the cells' tags.
+  if (!bound_measure_cells_.empty()) {
+    absl::MutexLock l(&shards_[0]->mu);
+    last_deltas_[0].CopyConsumerConfiguration(shards_[0]->delta);
+  }
+  for (auto it = bound_measure_cells_.begin();
+       it != bound_measure_cells_.end();) {
+    BoundMeasureCell* cell = it->get();
+    cell->HarvestInto(&last_deltas_[0],
+                      registered_boundaries_[cell->measure_index_],
+                      registered_statistics_[cell->measure_index_]);
+    if (it->use_count() == 1) {
+      // All BoundMeasures using the cell are gone, and nothing else can record
+      // to it.
+      it = bound_measure_cells_.erase(it);
+    } else {
+      ++it;
+    }
+  }
 }
 
 void DeltaProducer::ConsumeLastDelta() {
-  StatsManager::Get()->MergeDelta(last_delta_);
-  last_delta_.clear();
+  StatsManager::Get()->MergeDeltas(last_deltas_);
+  for (auto& last_delta : last_deltas_) {
+    last_delta.clear();
+  }
+}
+
+void DeltaProducer::UpdateMeasureColumns() {
+  std::vector<std::vector<opencensus::tags::TagKey>> measure_columns(
+      column_counts_.size());
+  for (size_t i = 0; i < column_counts_.size(); ++i) {
+    for (const auto& column_count : column_counts_[i]) {
+      measure_columns[i].push_back(column_count.first);
+    }
+  }
+  for (auto& shard : shards_) {
+    absl::MutexLock l(&shard->mu);
+    shard->delta.set_measure_columns(measure_columns);
+  }
+}
+
+absl::optional<DeltaProducer::FlushReason>
+DeltaProducer::WaitForHarvesterWakeup(absl::Time deadline) {
+  absl::MutexLock l(&harvest_options_mu_);
+  harvest_options_mu_.AwaitWithDeadline(absl::Condition(&harvester_wakeup_),
+                                        deadline);
+  harvester_wakeup_ = false;
+  absl::optional<FlushReason> reason = early_flush_reason_;
+  early_flush_reason_.reset();
+  return reason;
+}
+
+void DeltaProducer::UpdateHarvestInterval(FlushReason reason,
+                                          size_t num_entries) {
+  absl::MutexLock l(&harvest_options_mu_);
+  if (reason == FlushReason::kInterval &&
+      num_entries <= harvest_options_.idle_shard_entries) {
+    effective_harvest_interval_ =
+        std::max(harvest_options_.harvest_interval,
+                 std::min(2 * effective_harvest_interval_,
+                          harvest_options_.max_harvest_interval));
+  } else {
+    effective_harvest_interval_ = harvest_options_.harvest_interval;
+  }
 }
 
 void DeltaProducer::RunHarvesterLoop() {
-  absl::Time next_harvest_time = absl::Now() + harvest_interval_;
+  absl::Time last_harvest_time = absl::Now();
   while (true) {
+    // Recomputed on every wakeup, since the interval may have been changed.
+    const absl::Time next_harvest_time =
+        last_harvest_time + harvest_interval();
+    absl::Time wakeup_time = next_harvest_time;
+    if (record_mode_.load(std::memory_order_relaxed) == RecordMode::kQueued) {
+      // While recording is queued, wake up regularly to drain the queue so that
+      // it does not fill up between harvests.
+      wakeup_time =
+          std::min(wakeup_time, absl::Now() + kRecordQueueDrainInterval);
+    }
+    absl::optional<FlushReason> reason = WaitForHarvesterWakeup(wakeup_time);
+    DrainRecordQueue();
     const absl::Time now = absl::Now();
-    absl::SleepFor(next_harvest_time - now);
-    // Account for the possibility that the last harvest took longer than
-    // harvest_interval_ and we are already past next_harvest_time.
-    next_harvest_time = std::max(next_harvest_time, now) + harvest_interval_;
-    Flush();
+    if (!reason.has_value()) {
+      if (now < next_harvest_time) {
+        continue;
+      }
+      reason = FlushReason::kInterval;
+    }
+    // An early flush restarts the interval.
+    last_harvest_time = now;
+    UpdateHarvestInterval(*reason, FlushForReason(*reason));
   }
 }
 
@@ -15,18 +15,25 @@
 #ifndef OPENCENSUS_STATS_INTERNAL_DELTA_PRODUCER_H_
 #define OPENCENSUS_STATS_INTERNAL_DELTA_PRODUCER_H_
 
+#include <atomic>
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <thread>
-#include <unordered_map>
 #include <vector>
 
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "opencensus/stats/aggregation.h"
 #include "opencensus/stats/bucket_boundaries.h"
 #include "opencensus/stats/distribution.h"
+#include "opencensus/stats/internal/delta_table.h"
 #include "opencensus/stats/internal/measure_data.h"
+#include "opencensus/stats/internal/record_queue.h"
 #include "opencensus/stats/measure.h"
+#include "opencensus/tags/tag_key.h"
 #include "opencensus/tags/tag_map.h"
 
 namespace opencensus {
@@ -35,34 +42,147 @@ namespace stats {
 // Delta is thread-compatible.
 class Delta final {
  public:
-  void Record(std::initializer_list<Measurement> measurements,
-              opencensus::tags::TagMap tags);
+  // Records 'measurements' under 'tags', skipping measurements of measures
+  // without consumers. If no measurement remains, 'tags' is not looked up.
+  // Each measurement is recorded under 'tags' projected onto its measure's
+  // columns.
+  void Record(absl::Span<const Measurement> measurements,
+              const opencensus::tags::TagMap& tags);
+
+  // Records each of 'values' for the measure with index 'measure_index' under
+  // 'tags', as Record() would, using MeasureData::AddBatch().
+  void RecordBatch(uint64_t measure_index, absl::Span<const double> values,
+                   const opencensus::tags::TagMap& tags);
+
+  // Adds 'data' for the measure with index 'measure_index' under 'tags', as
+  // Record() would: nothing is added for a measure without consumers, and
+  // 'tags' is projected onto the measure's columns. Requires that 'data' was
+  // constructed with this delta's boundaries for that measure.
+  void AddMeasureData(uint64_t measure_index,
+                      const opencensus::tags::TagMap& tags,
+                      const MeasureData& data);
 
-  // Swaps registered_boundaries_ and delta_ with *other, clears delta_, and
-  // updates registered_boundaries_.
+  // Swaps registered_boundaries_, registered_statistics_ and delta_ with
+  // *other, clears delta_, and updates registered_boundaries_ and
+  // registered_statistics_. Measures beyond the end of 'registered_statistics'
+  // maintain all statistics.
   void SwapAndReset(
-      std::vector<std::vector<BucketBoundaries>>& registered_boundaries,
-      Delta* other);
+      const std::vector<std::vector<BucketBoundaries>>& registered_boundaries,
+      Delta* other,
+      const std::vector<MeasureData::Statistics>& registered_statistics = {});
 
-  // Clears registered_boundaries_ and delta_.
+  // Clears delta_, keeping its storage for reuse.
   void clear();
 
-  const std::unordered_map<opencensus::tags::TagMap, std::vector<MeasureData>,
-                           opencensus::tags::TagMap::Hash>&
-  delta() const {
-    return delta_;
+  // Sets which measures, by index, have consumers. Measures beyond the end of
+  // 'measure_has_consumers' are assumed to have consumers. Unlike
+  // registered_boundaries_, this stays with the delta across SwapAndReset().
+  void set_measure_has_consumers(
+      const std::vector<bool>& measure_has_consumers) {
+    measure_has_consumers_ = measure_has_consumers;
+  }
+
+  // Sets the tag keys that the views of each measure use, by index. Tags with
+  // other keys are dropped before recording to a measure, so that tagsets
+  // differing only in unused tags share a row. Measures beyond the end of
+  // 'measure_columns' keep all their tags. Each element must be sorted. Like
+  // the consumer flags, this stays with the delta across SwapAndReset().
+  void set_measure_columns(
+      std::vector<std::vector<opencensus::tags::TagKey>> measure_columns) {
+    measure_columns_ = std::move(measure_columns);
+    projection_cache_.clear();
   }
 
+  // Copies the consumer flags and measure columns of 'other'.
+  void CopyConsumerConfiguration(const Delta& other);
+
+  const DeltaTable& delta() const { return delta_; }
+
+  // An estimate of the memory used by the rows of delta_, not counting pooled
+  // rows or the table itself.
+  size_t approximate_bytes() const { return approximate_bytes_; }
+
  private:
   // A copy of registered_boundaries_ in the DeltaProducer as of when the
   // delta was started.
   std::vector<std::vector<BucketBoundaries>> registered_boundaries_;
+  // Likewise for the statistics each measure's views need.
+  std::vector<MeasureData::Statistics> registered_statistics_;
+
+  // Returns 'tags' projected onto the columns of the measure with index
+  // 'measure_index'. The result is valid until the next call.
+  const opencensus::tags::TagMap& ProjectTags(
+      uint64_t measure_index, const opencensus::tags::TagMap& tags);
 
-  // The actual data. Each MeasureData[] contains one element for each
-  // registered measure.
-  std::unordered_map<opencensus::tags::TagMap, std::vector<MeasureData>,
-                     opencensus::tags::TagMap::Hash>
-      delta_;
+  // Returns the row for 'tags', creating it if necessary.
+  DeltaTable::Row& FindOrCreate(const opencensus::tags::TagMap& tags);
+  // Returns the data for the measure with index 'measure_index' in 'row',
+  // adding it if necessary.
+  MeasureData& FindOrCreateData(DeltaTable::Row* row, uint64_t measure_index);
+
+  // The actual data. Each row contains an entry for each measure recorded
+  // under its tags. Entries refer to registered_boundaries_ and were created
+  // with registered_statistics_, so pooled rows in delta_ are discarded when
+  // either changes.
+  DeltaTable delta_;
+
+  std::vector<bool> measure_has_consumers_;
+  std::vector<std::vector<opencensus::tags::TagKey>> measure_columns_;
+
+  // A direct-mapped cache of recent projections, so that recording again
+  // under the same tags does not copy them. Empty until first used.
+  struct CachedProjection {
+    uint64_t measure_index;
+    opencensus::tags::TagMap tags;
+    opencensus::tags::TagMap projected;
+  };
+  std::vector<absl::optional<CachedProjection>> projection_cache_;
+
+  // The estimated size of an entry for each measure, given
+  // registered_boundaries_ and registered_statistics_.
+  std::vector<size_t> entry_bytes_;
+  size_t approximate_bytes_ = 0;
+};
+
+// BoundMeasureCell aggregates the values recorded through a BoundMeasure (and
+// its copies) between harvests. It is owned jointly by the BoundMeasures and
+// the DeltaProducer, which harvests it into the delta on every flush.
+//
+// BoundMeasureCell is thread-safe.
+class BoundMeasureCell final {
+ public:
+  BoundMeasureCell(uint64_t measure_index, opencensus::tags::TagMap tags,
+                   const std::vector<BucketBoundaries>& boundaries,
+                   MeasureData::Statistics statistics);
+
+  void Add(double value);
+
+ private:
+  friend class DeltaProducer;
+
+  // Adds the data recorded since the last harvest to 'delta', and resets the
+  // cell with the given (possibly updated) boundaries and statistics. Holds
+  // every shard's mutex, which the analysis cannot follow through the loop.
+  void HarvestInto(Delta* delta,
+                   const std::vector<BucketBoundaries>& boundaries,
+                   MeasureData::Statistics statistics)
+      NO_THREAD_SAFETY_ANALYSIS;
+
+  // The data recorded by the threads assigned to one shard, as for the delta
+  // shards, so that threads sharing a hot BoundMeasure usually lock different
+  // mutexes.
+  struct Shard {
+    absl::Mutex mu;
+    absl::optional<MeasureData> data GUARDED_BY(mu);
+  };
+
+  const uint64_t measure_index_;
+  const opencensus::tags::TagMap tags_;
+
+  const std::vector<std::unique_ptr<Shard>> shards_;
+  // A copy of the measure's boundaries as of the last harvest, which the
+  // shards' data refers to. Changed only while holding every shard's mutex.
+  std::vector<BucketBoundaries> boundaries_;
 };
 
 // DeltaProducer is thread-safe.
@@ -71,24 +191,186 @@ class DeltaProducer final {
   // Returns a pointer to the singleton DeltaProducer.
   static DeltaProducer* Get();
 
-  // Adds a new Measure.
+  // How Record() adds measurements to the active delta.
+  enum class RecordMode {
+    // Record() aggregates directly into the calling thread's delta shard.
+    kLocked,
+    // Record() pushes measurements onto a bounded lock-free queue, which the
+    // harvester thread drains into the active delta. This moves aggregation
+    // off the recording thread.
+    kQueued,
+  };
+
+  // What Record() does in kQueued mode when the queue is full.
+  enum class OverflowPolicy {
+    // Drops the measurements, incrementing dropped_records().
+    kDrop,
+    // Aggregates the measurements directly, as in kLocked mode.
+    kRecordLocked,
+  };
+
+  // Sets the record mode. Records already queued are aggregated on the next
+  // drain or flush regardless of the new mode.
+  void SetRecordMode(RecordMode mode,
+                     OverflowPolicy overflow_policy = OverflowPolicy::kDrop)
+      LOCKS_EXCLUDED(delta_mu_);
+
+  // Returns the number of Record() calls dropped because the record queue was
+  // full.
+  uint64_t dropped_records() const {
+    return dropped_records_.load(std::memory_order_relaxed);
+  }
+
+  // Controls when the harvester flushes the active delta.
+  struct HarvestOptions {
+    // The interval between harvests.
+    absl::Duration harvest_interval = absl::Seconds(5);
+    // The limits below count shard entries: the tagsets of each shard of the
+    // active delta, summed over the shards, so that a tagset recorded from
+    // threads on several shards counts once per shard. They bound memory
+    // rather than the number of distinct tagsets.
+    //
+    // While harvests find at most idle_shard_entries entries, the interval
+    // doubles after each harvest up to max_harvest_interval, saving wakeups in
+    // idle processes. It drops back to harvest_interval on the first harvest
+    // that finds more. By default the interval does not stretch.
+    absl::Duration max_harvest_interval = absl::Seconds(5);
+    size_t idle_shard_entries = 0;
+    // The harvester flushes early once the active delta holds this many shard
+    // entries or an estimated this many bytes, bounding its memory between
+    // harvests. Records made before the harvester wakes up may overshoot the
+    // limit. Zero disables the limit.
+    size_t max_shard_entries = 0;
+    size_t max_bytes = 0;
+  };
+
+  // Why the active delta was flushed.
+  enum class FlushReason {
+    // The harvest interval elapsed.
+    kInterval,
+    // The active delta reached HarvestOptions::max_shard_entries.
+    kEntryLimit,
+    // The active delta reached HarvestOptions::max_bytes.
+    kByteLimit,
+    // Flush() was called.
+    kExplicit,
+  };
+
+  // Replaces the harvest options. Takes effect for the next harvest.
+  void SetHarvestOptions(const HarvestOptions& options)
+      LOCKS_EXCLUDED(harvest_options_mu_);
+
+  // Returns the current interval between harvests, which is longer than
+  // HarvestOptions::harvest_interval while the interval is stretched.
+  absl::Duration harvest_interval() const LOCKS_EXCLUDED(harvest_options_mu_);
+
+  // Returns the number of flushes so far for 'reason'.
+  uint64_t num_flushes(FlushReason reason) const {
+    return num_flushes_[static_cast<int>(reason)].load(
+        std::memory_order_relaxed);
+  }
+
+  // Adds a new Measure, which has no consumers until
+  // SetMeasureHasConsumers(index, true) is called.
   void AddMeasure();
 
+  // Sets whether any view consumes the measure with index 'measure_index'.
+  // Record() drops measurements of measures without consumers before touching
+  // the delta.
+  void SetMeasureHasConsumers(uint64_t measure_index, bool has_consumers)
+      LOCKS_EXCLUDED(consumers_mu_);
+
+  // Adds or removes the columns of one consumer of a view of the measure
+  // 'measure_index'. Record() keeps only the tags whose keys are columns of
+  // some view of the measure. Must be called before the consumer is added and
+  // after it is removed. Adding a new column flushes the active delta, so that
+  // data recorded without it is not attributed to the new view.
+  void AddViewColumns(uint64_t measure_index,
+                      const std::vector<opencensus::tags::TagKey>& columns)
+      LOCKS_EXCLUDED(delta_mu_, harvester_mu_);
+  void RemoveViewColumns(uint64_t measure_index,
+                         const std::vector<opencensus::tags::TagKey>& columns)
+      LOCKS_EXCLUDED(delta_mu_);
+
+  // Adds or removes the aggregation type of one consumer of a view of the
+  // measure 'measure_index'. The measure's deltas maintain only the statistics
+  // that its views' aggregations need. Must be called before the consumer is
+  // added and after it is removed. Needing more statistics flushes the active
+  // delta, so that its data is complete for the new view; needing fewer takes
+  // effect on the next flush.
+  void AddViewAggregation(uint64_t measure_index, Aggregation::Type type)
+      LOCKS_EXCLUDED(delta_mu_, harvester_mu_);
+  void RemoveViewAggregation(uint64_t measure_index, Aggregation::Type type)
+      LOCKS_EXCLUDED(delta_mu_);
+
   // Adds a new BucketBoundaries for the measure 'index' if it does not already
   // exist.
   void AddBoundaries(uint64_t index, const BucketBoundaries& boundaries);
 
+  // Records into the active delta shard of the calling thread. Only that
+  // shard's mutex is acquired, so threads on different shards do not contend.
+  // 'tags' is only copied if the delta has no row for it yet.
   void Record(std::initializer_list<Measurement> measurements,
-              opencensus::tags::TagMap tags) LOCKS_EXCLUDED(delta_mu_);
+              const opencensus::tags::TagMap& tags) LOCKS_EXCLUDED(delta_mu_);
+  // Records 'values' for the measure with index 'measure_index' into the
+  // calling thread's shard, bypassing the record queue in kQueued mode.
+  void RecordBatch(uint64_t measure_index, absl::Span<const double> values,
+                   const opencensus::tags::TagMap& tags)
+      LOCKS_EXCLUDED(delta_mu_);
 
   // Flushes the active delta and blocks until it is harvested.
   void Flush() LOCKS_EXCLUDED(delta_mu_, harvester_mu_);
 
+  // Returns a new cell for recording to the measure with index
+  // 'measure_index' under 'tags', which will be harvested on every flush until
+  // released by all its owners.
+  std::shared_ptr<BoundMeasureCell> AddBoundMeasureCell(
+      uint64_t measure_index, opencensus::tags::TagMap tags)
+      LOCKS_EXCLUDED(delta_mu_);
+
+  // Returns the number of shards the active delta is split into.
+  int num_shards() const { return shards_.size(); }
+
  private:
+  // One shard of the active delta. Each recording thread is assigned to a
+  // single shard, so that Record() calls from different threads usually lock
+  // different mutexes. Shard mutexes are acquired after delta_mu_,
+  // consumers_mu_ and harvester_mu_.
+  struct DeltaShard {
+    absl::Mutex mu;
+    Delta delta GUARDED_BY(mu);
+  };
+
   DeltaProducer();
 
-  // Flushing has two stages: swapping active_delta_ to last_delta_ and
-  // consuming last_delta_. Callers should release delta_mu_ before calling
+  // Returns the shard assigned to the calling thread.
+  DeltaShard* ShardForCurrentThread();
+
+  // Aggregates all queued records into the first shard of the active delta.
+  void DrainRecordQueue();
+
+  // Accounts for 'entries' new shard entries taking 'bytes' in the active
+  // delta, waking the harvester for an early flush if that exceeds a limit.
+  void AddActiveUsage(size_t entries, size_t bytes)
+      LOCKS_EXCLUDED(harvest_options_mu_);
+
+  // Flushes the active delta and counts the flush under 'reason'. Returns the
+  // number of shard entries flushed.
+  size_t FlushForReason(FlushReason reason)
+      LOCKS_EXCLUDED(delta_mu_, harvester_mu_);
+
+  // Blocks until 'deadline' or until the harvester is woken up, returning the
+  // reason for an early flush if one was requested.
+  absl::optional<FlushReason> WaitForHarvesterWakeup(absl::Time deadline)
+      LOCKS_EXCLUDED(harvest_options_mu_);
+
+  // Stretches or resets the harvest interval after a flush for 'reason' that
+  // found 'num_entries' shard entries.
+  void UpdateHarvestInterval(FlushReason reason, size_t num_entries)
+      LOCKS_EXCLUDED(harvest_options_mu_);
+
+  // Flushing has two stages: swapping the active delta shards to last_deltas_
+  // and consuming last_deltas_. Callers should release delta_mu_ before calling
   // ConsumeLastDelta so that Record() is blocked for as little time as
   // possible. SwapDeltas should never be called without then calling
   // ConsumeLastDelta--otherwise the delta will be lost.
@@ -96,31 +378,105 @@ class DeltaProducer final {
   void ConsumeLastDelta() EXCLUSIVE_LOCKS_REQUIRED(harvester_mu_)
       LOCKS_EXCLUDED(delta_mu_);
 
+  // Copies the columns in column_counts_ to every shard's delta.
+  void UpdateMeasureColumns() EXCLUSIVE_LOCKS_REQUIRED(delta_mu_);
+
+  // Recomputes registered_statistics_ for 'measure_index' from
+  // aggregation_counts_, returning whether it changed.
+  bool UpdateMeasureStatistics(uint64_t measure_index)
+      EXCLUSIVE_LOCKS_REQUIRED(delta_mu_);
+
   // Loops flushing the active delta (calling SwapDeltas and ConsumeLastDelta())
-  // every harvest_interval_.
+  // every harvest_interval(), and early when the active delta exceeds a limit.
   void RunHarvesterLoop();
 
-  const absl::Duration harvest_interval_ = absl::Seconds(5);
-
-  // Guards the active delta and its configuration. Anything that changes the
-  // delta configuration (e.g. adding a measure or BucketBoundaries) must
-  // acquire delta_mu_, update configuration, and call SwapDeltas() before
-  // releasing delta_mu_ to prevent Record() from accessing the delta with
-  // mismatched configuration.
+  // Guards the delta configuration. Anything that changes the delta
+  // configuration (e.g. adding a measure or BucketBoundaries) must acquire
+  // delta_mu_, update configuration, and call SwapDeltas() before releasing
+  // delta_mu_ to prevent Record() from accessing the delta with mismatched
+  // configuration. Record() does not acquire delta_mu_; each shard's delta
+  // carries its own copy of the configuration.
   mutable absl::Mutex delta_mu_;
 
   // The BucketBoundaries of each registered view with Distribution aggregation,
   // by measure. Array indices in the outer array correspond to measure indices.
   std::vector<std::vector<BucketBoundaries>> registered_boundaries_
       GUARDED_BY(delta_mu_);
-  Delta active_delta_ GUARDED_BY(delta_mu_);
 
-  // Guards the last_delta_; acquired by the main thread when triggering a
+  // The number of view consumers using each column, by measure index.
+  std::vector<std::map<opencensus::tags::TagKey, int>> column_counts_
+      GUARDED_BY(delta_mu_);
+
+  // The number of view consumers with each aggregation type, by measure index.
+  std::vector<std::map<Aggregation::Type, int>> aggregation_counts_
+      GUARDED_BY(delta_mu_);
+  // The statistics needed by the aggregations in aggregation_counts_, by
+  // measure index. Applied to the active delta by SwapDeltas().
+  std::vector<MeasureData::Statistics> registered_statistics_
+      GUARDED_BY(delta_mu_);
+  // registered_statistics_ as of the last SwapDeltas(), which the active delta
+  // maintains. New bound measure cells use these, since they are harvested
+  // into that delta.
+  std::vector<MeasureData::Statistics> active_statistics_
+      GUARDED_BY(delta_mu_);
+
+  // Guards measure_has_consumers_. This is separate from delta_mu_ because
+  // StatsManager updates it while holding its own mutex, which flushes acquire
+  // after delta_mu_.
+  absl::Mutex consumers_mu_ ACQUIRED_AFTER(delta_mu_);
+
+  // Whether each measure has consumers, by measure index. Copied to every
+  // shard's delta whenever it changes. May be longer than
+  // registered_boundaries_ if a view is added while its measure is still being
+  // registered.
+  std::vector<bool> measure_has_consumers_ GUARDED_BY(consumers_mu_);
+
+  // All cells backing BoundMeasures. Cells are dropped after the harvest
+  // following the destruction of their last BoundMeasure.
+  std::vector<std::shared_ptr<BoundMeasureCell>> bound_measure_cells_
+      GUARDED_BY(delta_mu_);
+
+  // The shards of the active delta. The number of shards is fixed at
+  // construction, so this may be read without holding any lock.
+  const std::vector<std::unique_ptr<DeltaShard>> shards_;
+
+  // The record mode and overflow policy, as set by SetRecordMode().
+  std::atomic<RecordMode> record_mode_{RecordMode::kLocked};
+  std::atomic<OverflowPolicy> overflow_policy_{OverflowPolicy::kDrop};
+  // The queue for kQueued mode, created on the first switch to kQueued and
+  // never destroyed.
+  std::atomic<RecordQueue*> record_queue_{nullptr};
+  std::atomic<uint64_t> dropped_records_{0};
+
+  // Guards last_deltas_; acquired by the main thread when triggering a
   // flush.
   mutable absl::Mutex harvester_mu_ ACQUIRED_AFTER(delta_mu_);
   // TODO: consider making this a lockless queue to avoid blocking the main
   // thread when calling a flush during harvesting.
-  Delta last_delta_ GUARDED_BY(harvester_mu_);
+  // The last delta of each shard, indexed as shards_.
+  std::vector<Delta> last_deltas_ GUARDED_BY(harvester_mu_);
+
+  // Guards the harvest options and the harvester's wakeup state.
+  mutable absl::Mutex harvest_options_mu_ ACQUIRED_AFTER(harvester_mu_);
+  HarvestOptions harvest_options_ GUARDED_BY(harvest_options_mu_);
+  absl::Duration effective_harvest_interval_ GUARDED_BY(harvest_options_mu_) =
+      harvest_options_.harvest_interval;
+  // Set to wake up the harvester before its next harvest is due.
+  bool harvester_wakeup_ GUARDED_BY(harvest_options_mu_) = false;
+  absl::optional<FlushReason> early_flush_reason_
+      GUARDED_BY(harvest_options_mu_);
+
+  // The limits from harvest_options_, readable by Record() without locking.
+  std::atomic<size_t> max_shard_entries_{0};
+  std::atomic<size_t> max_bytes_{0};
+  // The usage of the active delta, reset by SwapDeltas().
+  std::atomic<size_t> active_entries_{0};
+  std::atomic<size_t> active_bytes_{0};
+  // Whether an early flush has been requested since the last SwapDeltas(), so
+  // that only the first record over a limit wakes the harvester.
+  std::atomic<bool> early_flush_requested_{false};
+  std::atomic<uint64_t> num_flushes_[4] = {};
+
   std::thread harvester_thread_ GUARDED_BY(harvester_mu_);
 };
 
@@ -0,0 +1,197 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "opencensus/stats/internal/delta_producer.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "opencensus/stats/bucket_boundaries.h"
+#include "opencensus/stats/internal/measure_registry_impl.h"
+#include "opencensus/stats/measure.h"
+#include "opencensus/tags/tag_key.h"
+#include "opencensus/tags/tag_map.h"
+
+namespace opencensus {
+namespace stats {
+namespace {
+
+MeasureDouble FirstMeasure() {
+  static const MeasureDouble measure =
+      MeasureDouble::Register("delta_producer_test_measure_1", "", "");
+  return measure;
+}
+
+MeasureDouble SecondMeasure() {
+  static const MeasureDouble measure =
+      MeasureDouble::Register("delta_producer_test_measure_2", "", "");
+  return measure;
+}
+
+uint64_t FirstIndex() {
+  return MeasureRegistryImpl::MeasureToIndex(FirstMeasure());
+}
+uint64_t SecondIndex() {
+  return MeasureRegistryImpl::MeasureToIndex(SecondMeasure());
+}
+
+// Returns an empty Delta configured for all measures up to SecondMeasure().
+Delta MakeDelta() {
+  std::vector<std::vector<BucketBoundaries>> boundaries(
+      std::max(FirstIndex(), SecondIndex()) + 1);
+  Delta delta;
+  Delta unused;
+  delta.SwapAndReset(boundaries, &unused);
+  return delta;
+}
+
+TEST(DeltaTest, SkipsMeasuresWithoutConsumers) {
+  const auto key = opencensus::tags::TagKey::Register("key");
+  Delta delta = MakeDelta();
+  std::vector<bool> measure_has_consumers(
+      std::max(FirstIndex(), SecondIndex()) + 1, true);
+  measure_has_consumers[SecondIndex()] = false;
+  delta.set_measure_has_consumers(measure_has_consumers);
+
+  // Nothing is recorded, and no row is created, for a measure without
+  // consumers.
+  delta.Record({{SecondMeasure(), 1.0}}, {{key, "value1"}});
+  EXPECT_TRUE(delta.delta().empty());
+
+  delta.Record({{FirstMeasure(), 1.0}, {SecondMeasure(), 1.0}},
+               {{key, "value2"}});
+  ASSERT_EQ(1, delta.delta().size());
+  const DeltaTable::Row& row = delta.delta().row(0);
+  ASSERT_NE(nullptr, DeltaTable::FindEntry(row, FirstIndex()));
+  EXPECT_EQ(1, DeltaTable::FindEntry(row, FirstIndex())->data.count());
+  EXPECT_EQ(nullptr, DeltaTable::FindEntry(row, SecondIndex()));
+}
+
+TEST(DeltaTest, ProjectsTagsOntoColumns) {
+  const auto key1 = opencensus::tags::TagKey::Register("key1");
+  const auto key2 = opencensus::tags::TagKey::Register("key2");
+  Delta delta = MakeDelta();
+  std::vector<std::vector<opencensus::tags::TagKey>> measure_columns(
+      std::max(FirstIndex(), SecondIndex()) + 1);
+  measure_columns[FirstIndex()] = {key1};
+  measure_columns[SecondIndex()] = {key1, key2};
+  std::sort(measure_columns[SecondIndex()].begin(),
+            measure_columns[SecondIndex()].end());
+  delta.set_measure_columns(measure_columns);
+
+  delta.Record({{FirstMeasure(), 1.0}}, {{key1, "value1"}, {key2, "value2"}});
+  delta.Record({{FirstMeasure(), 1.0}}, {{key1, "value1"}, {key2, "value3"}});
+  ASSERT_EQ(1, delta.delta().size());
+  EXPECT_EQ(opencensus::tags::TagMap({{key1, "value1"}}),
+            delta.delta().tags(0));
+  EXPECT_EQ(2, DeltaTable::FindEntry(delta.delta().row(0), FirstIndex())
+                   ->data.count());
+
+  // Measures with different columns are recorded to different rows.
+  delta.Record({{FirstMeasure(), 1.0}, {SecondMeasure(), 1.0}},
+               {{key1, "value1"}, {key2, "value2"}});
+  ASSERT_EQ(2, delta.delta().size());
+  EXPECT_EQ(3, DeltaTable::FindEntry(delta.delta().row(0), FirstIndex())
+                   ->data.count());
+  EXPECT_EQ(opencensus::tags::TagMap({{key1, "value1"}, {key2, "value2"}}),
+            delta.delta().tags(1));
+  EXPECT_EQ(1, DeltaTable::FindEntry(delta.delta().row(1), SecondIndex())
+                   ->data.count());
+}
+
+TEST(DeltaTest, ConsumersSurviveSwap) {
+  const auto key = opencensus::tags::TagKey::Register("key");
+  Delta delta = MakeDelta();
+  std::vector<bool> measure_has_consumers(
+      std::max(FirstIndex(), SecondIndex()) + 1, false);
+  delta.set_measure_has_consumers(measure_has_consumers);
+
+  Delta other;
+  std::vector<std::vector<BucketBoundaries>> boundaries(
+      measure_has_consumers.size());
+  delta.SwapAndReset(boundaries, &other);
+  delta.Record({{FirstMeasure(), 1.0}}, {{key, "value"}});
+  EXPECT_TRUE(delta.delta().empty());
+}
+
+TEST(DeltaTest, AddMeasureDataProjectsTags) {
+  const auto key1 = opencensus::tags::TagKey::Register("key1");
+  const auto key2 = opencensus::tags::TagKey::Register("key2");
+  Delta configured = MakeDelta();
+  std::vector<bool> measure_has_consumers(
+      std::max(FirstIndex(), SecondIndex()) + 1, true);
+  measure_has_consumers[SecondIndex()] = false;
+  configured.set_measure_has_consumers(measure_has_consumers);
+  std::vector<std::vector<opencensus::tags::TagKey>> measure_columns(
+      measure_has_consumers.size());
+  measure_columns[FirstIndex()] = {key1};
+  configured.set_measure_columns(measure_columns);
+  Delta delta = MakeDelta();
+  delta.CopyConsumerConfiguration(configured);
+
+  MeasureData data({});
+  data.Add(1);
+  delta.AddMeasureData(FirstIndex(), {{key1, "value1"}, {key2, "value2"}},
+                       data);
+  delta.AddMeasureData(FirstIndex(), {{key1, "value1"}, {key2, "value3"}},
+                       data);
+  // Nothing is added for a measure without consumers.
+  delta.AddMeasureData(SecondIndex(), {{key1, "value1"}}, data);
+  ASSERT_EQ(1, delta.delta().size());
+  EXPECT_EQ(opencensus::tags::TagMap({{key1, "value1"}}),
+            delta.delta().tags(0));
+  EXPECT_EQ(2, DeltaTable::FindEntry(delta.delta().row(0), FirstIndex())
+                   ->data.count());
+  EXPECT_EQ(nullptr,
+            DeltaTable::FindEntry(delta.delta().row(0), SecondIndex()));
+}
+
+TEST(DeltaTest, MaintainsRegisteredStatistics) {
+  const auto key = opencensus::tags::TagKey::Register("key");
+  const std::vector<std::vector<BucketBoundaries>> boundaries(
+      std::max(FirstIndex(), SecondIndex()) + 1,
+      {BucketBoundaries::Explicit({0})});
+  std::vector<MeasureData::Statistics> statistics(
+      boundaries.size(), MeasureData::Statistics::kAll);
+  statistics[FirstIndex()] = MeasureData::Statistics::kSum;
+  Delta delta;
+  Delta other;
+  delta.SwapAndReset(boundaries, &other, statistics);
+
+  delta.Record({{FirstMeasure(), 2.0}, {SecondMeasure(), 3.0}},
+               {{key, "value"}});
+  ASSERT_EQ(1, delta.delta().size());
+  const MeasureData& first_data =
+      DeltaTable::FindEntry(delta.delta().row(0), FirstIndex())->data;
+  EXPECT_EQ(MeasureData::Statistics::kSum, first_data.statistics());
+  EXPECT_EQ(2, first_data.sum());
+  EXPECT_EQ(MeasureData::Statistics::kAll,
+            DeltaTable::FindEntry(delta.delta().row(0), SecondIndex())
+                ->data.statistics());
+
+  // Rows pooled under the old statistics are not reused under new ones.
+  statistics[FirstIndex()] = MeasureData::Statistics::kAll;
+  delta.SwapAndReset(boundaries, &other, statistics);
+  other.clear();
+  delta.SwapAndReset(boundaries, &other, statistics);
+  delta.Record({{FirstMeasure(), 2.0}}, {{key, "value"}});
+  EXPECT_EQ(MeasureData::Statistics::kAll,
+            DeltaTable::FindEntry(delta.delta().row(0), FirstIndex())
+                ->data.statistics());
+}
+
+}  // namespace
+}  // namespace stats
+}  // namespace opencensus
@@ -0,0 +1,156 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "opencensus/stats/internal/delta_table.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "opencensus/tags/tag_map.h"
+
+namespace opencensus {
+namespace stats {
+
+namespace {
+
+constexpr size_t kInitialNumSlots = 16;
+// The number of clear() calls over which the peak size is taken when deciding
+// whether to shrink.
+constexpr int kClearsPerShrinkCheck = 4;
+// The table is only shrunk when it would become at least this many times
+// smaller, so that sizes near a boundary do not cause repeated reallocation.
+constexpr size_t kShrinkFactor = 4;
+
+}  // namespace
+
+DeltaTable::DeltaTable() : slots_(kInitialNumSlots, Slot{0, 0}) {}
+
+const DeltaTable::Entry* DeltaTable::FindEntry(const Row& row,
+                                               uint64_t measure_index) {
+  // Rows are short (one entry per measure recorded under a tagset), so a
+  // linear scan beats any index.
+  for (const auto& entry : row) {
+    if (entry.measure_index == measure_index) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+DeltaTable::Entry* DeltaTable::FindEntry(Row* row, uint64_t measure_index) {
+  return const_cast<Entry*>(FindEntry(*row, measure_index));
+}
+
+const DeltaTable::Row* DeltaTable::Find(
+    const opencensus::tags::TagMap& tags) const {
+  const Slot& slot =
+      slots_[FindSlot(tags, opencensus::tags::TagMap::Hash()(tags))];
+  return slot.index == 0 ? nullptr : &rows_[slot.index - 1];
+}
+
+DeltaTable::Row& DeltaTable::FindOrInsert(const opencensus::tags::TagMap& tags,
+                                          bool* inserted) {
+  const size_t hash = opencensus::tags::TagMap::Hash()(tags);
+  size_t slot_index = FindSlot(tags, hash);
+  if (slots_[slot_index].index != 0) {
+    *inserted = false;
+    return rows_[slots_[slot_index].index - 1];
+  }
+  // Keep the load factor at or below 1/2, so that probe sequences stay short.
+  if (2 * (size_ + 1) > slots_.size()) {
+    Grow();
+    slot_index = FindSlot(tags, hash);
+  }
+  *inserted = true;
+  keys_.push_back(tags);
+  if (size_ == rows_.size()) {
+    rows_.emplace_back();
+  }
+  ++size_;
+  slots_[slot_index] = Slot{hash, static_cast<uint32_t>(size_)};
+  return rows_[size_ - 1];
+}
+
+void DeltaTable::clear() {
+  if (size_ != 0) {
+    for (auto& slot : slots_) {
+      slot = Slot{0, 0};
+    }
+    keys_.clear();
+    peak_size_ = std::max(peak_size_, size_);
+    size_ = 0;
+  }
+  if (++clears_since_shrink_check_ == kClearsPerShrinkCheck) {
+    MaybeShrink();
+    peak_size_ = 0;
+    clears_since_shrink_check_ = 0;
+  }
+}
+
+void DeltaTable::ClearPool() {
+  clear();
+  rows_.clear();
+}
+
+size_t DeltaTable::FindSlot(const opencensus::tags::TagMap& tags,
+                            size_t hash) const {
+  const size_t mask = slots_.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const Slot& slot = slots_[i];
+    if (slot.index == 0 ||
+        (slot.hash == hash && keys_[slot.index - 1] == tags)) {
+      return i;
+    }
+  }
+}
+
+void DeltaTable::MaybeShrink() {
+  size_t num_slots = kInitialNumSlots;
+  while (2 * peak_size_ > num_slots) {
+    num_slots *= 2;
+  }
+  if (kShrinkFactor * num_slots > slots_.size()) {
+    return;
+  }
+  // The table is empty, so the slots need no rehashing.
+  std::vector<Slot>(num_slots, Slot{0, 0}).swap(slots_);
+  std::vector<opencensus::tags::TagMap>().swap(keys_);
+  keys_.reserve(peak_size_);
+  if (rows_.size() > peak_size_) {
+    rows_.resize(peak_size_);
+    rows_.shrink_to_fit();
+  }
+}
+
+void DeltaTable::Grow() {
+  std::vector<Slot> old_slots(2 * slots_.size(), Slot{0, 0});
+  old_slots.swap(slots_);
+  const size_t mask = slots_.size() - 1;
+  for (const auto& old_slot : old_slots) {
+    if (old_slot.index == 0) {
+      continue;
+    }
+    size_t i = old_slot.hash & mask;
+    while (slots_[i].index != 0) {
+      i = (i + 1) & mask;
+    }
+    slots_[i] = old_slot;
+  }
+}
+
+}  // namespace stats
+}  // namespace opencensus
@@ -0,0 +1,118 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OPENCENSUS_STATS_INTERNAL_DELTA_TABLE_H_
+#define OPENCENSUS_STATS_INTERNAL_DELTA_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "opencensus/stats/internal/measure_data.h"
+#include "opencensus/tags/tag_map.h"
+
+namespace opencensus {
+namespace stats {
+
+// DeltaTable maps TagMaps to rows of per-measure MeasureData. It is an
+// open-addressing hash table with linear probing over a flat slot array, with
+// keys and rows stored densely in insertion order.
+//
+// Rows are sparse: they hold entries only for the measures recorded under
+// their tags, so the cost of a tagset does not grow with the number of
+// registered measures.
+//
+// clear() does not free rows: they are kept in a pool and handed out again by
+// FindOrInsert(), so that in steady state a harvest interval allocates nothing
+// beyond the keys themselves. Recycled rows still hold the entries from before
+// the clear(); the caller is responsible for resetting them.
+//
+// So that a burst of high cardinality does not leave every later clear()
+// scanning, and the pool holding, its peak number of rows, clear() shrinks the
+// table back toward the largest size seen over its last several calls when
+// that is much smaller than the current capacity.
+//
+// DeltaTable is thread-compatible.
+class DeltaTable final {
+ public:
+  // The data for one measure within a row.
+  struct Entry {
+    uint64_t measure_index;
+    MeasureData data;
+  };
+  // Entries are in no particular order, and there is at most one per measure.
+  typedef std::vector<Entry> Row;
+
+  DeltaTable();
+
+  // Returns the entry for 'measure_index' in 'row', or nullptr if there is
+  // none.
+  static const Entry* FindEntry(const Row& row, uint64_t measure_index);
+  static Entry* FindEntry(Row* row, uint64_t measure_index);
+
+  // Returns the row for 'tags', or nullptr if there is none.
+  const Row* Find(const opencensus::tags::TagMap& tags) const;
+
+  // Returns the row for 'tags', inserting one if needed. Sets *inserted to
+  // whether a row was inserted. An inserted row is either empty or a recycled
+  // row from before the last clear(). 'tags' is only copied on insertion.
+  Row& FindOrInsert(const opencensus::tags::TagMap& tags, bool* inserted);
+
+  // The number of rows, which are indexed [0, size()) in insertion order.
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const opencensus::tags::TagMap& tags(size_t index) const {
+    return keys_[index];
+  }
+  const Row& row(size_t index) const { return rows_[index]; }
+  // The number of slots, which bounds the cost of clear().
+  size_t capacity() const { return slots_.size(); }
+
+  // Removes all rows, keeping them for reuse.
+  void clear();
+  // Removes all rows and frees the pool of rows for reuse, e.g. when their
+  // layout is no longer valid.
+  void ClearPool();
+
+ private:
+  struct Slot {
+    size_t hash;
+    // The index of the row plus one, or zero if the slot is empty.
+    uint32_t index;
+  };
+
+  // Returns the slot holding 'tags' (with 'hash'), or the empty slot where it
+  // would be inserted.
+  size_t FindSlot(const opencensus::tags::TagMap& tags, size_t hash) const;
+  void Grow();
+  // Shrinks the empty table to fit peak_size_ rows, if it is much larger.
+  void MaybeShrink();
+
+  // slots_.size() is a power of 2.
+  std::vector<Slot> slots_;
+  // The keys of the first size_ rows.
+  std::vector<opencensus::tags::TagMap> keys_;
+  // Rows [0, size_) are in use; the rest are pooled for reuse.
+  std::vector<Row> rows_;
+  size_t size_ = 0;
+  // The largest size_ since the last shrink check, and the number of clear()
+  // calls since then.
+  size_t peak_size_ = 0;
+  int clears_since_shrink_check_ = 0;
+};
+
+}  // namespace stats
+}  // namespace opencensus
+
+#endif  // OPENCENSUS_STATS_INTERNAL_DELTA_TABLE_H_
@@ -0,0 +1,137 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "opencensus/stats/internal/delta_table.h"
+
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+#include "opencensus/stats/bucket_boundaries.h"
+#include "opencensus/stats/internal/measure_data.h"
+#include "opencensus/tags/tag_key.h"
+#include "opencensus/tags/tag_map.h"
+
+namespace opencensus {
+namespace stats {
+namespace {
+
+TEST(DeltaTableTest, FindOrInsert) {
+  const auto key = opencensus::tags::TagKey::Register("key");
+  DeltaTable table;
+  EXPECT_TRUE(table.empty());
+
+  // Insert enough rows to force the table to grow several times.
+  const int kNumRows = 1000;
+  for (int i = 0; i < kNumRows; ++i) {
+    bool inserted;
+    DeltaTable::Row& row = table.FindOrInsert(
+        opencensus::tags::TagMap({{key, absl::StrCat("value", i)}}),
+        &inserted);
+    EXPECT_TRUE(inserted);
+    EXPECT_TRUE(row.empty());
+    row.push_back(DeltaTable::Entry{
+        0, MeasureData(absl::Span<const BucketBoundaries>())});
+    row[0].data.Add(i);
+  }
+  EXPECT_EQ(kNumRows, table.size());
+
+  for (int i = 0; i < kNumRows; ++i) {
+    const opencensus::tags::TagMap tags({{key, absl::StrCat("value", i)}});
+    bool inserted;
+    DeltaTable::Row& row = table.FindOrInsert(tags, &inserted);
+    EXPECT_FALSE(inserted);
+    EXPECT_EQ(i, row[0].data.last_value());
+    EXPECT_EQ(&row, table.Find(tags));
+    EXPECT_EQ(tags, table.tags(i));
+  }
+  EXPECT_EQ(nullptr,
+            table.Find(opencensus::tags::TagMap({{key, "missing_value"}})));
+}
+
+TEST(DeltaTableTest, ClearRecyclesRows) {
+  const auto key = opencensus::tags::TagKey::Register("key");
+  DeltaTable table;
+  bool inserted;
+  DeltaTable::Row& row =
+      table.FindOrInsert(opencensus::tags::TagMap({{key, "value1"}}),
+                         &inserted);
+  row.push_back(DeltaTable::Entry{
+      0, MeasureData(absl::Span<const BucketBoundaries>())});
+  const MeasureData* data = &row[0].data;
+
+  table.clear();
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(nullptr, table.Find(opencensus::tags::TagMap({{key, "value1"}})));
+  // A new row reuses the storage of the cleared row.
+  DeltaTable::Row& recycled_row =
+      table.FindOrInsert(opencensus::tags::TagMap({{key, "value2"}}),
+                         &inserted);
+  EXPECT_TRUE(inserted);
+  ASSERT_EQ(1, recycled_row.size());
+  EXPECT_EQ(data, &recycled_row[0].data);
+
+  table.ClearPool();
+  EXPECT_TRUE(
+      table.FindOrInsert(opencensus::tags::TagMap({{key, "value3"}}), &inserted)
+          .empty());
+}
+
+TEST(DeltaTableTest, ClearShrinksAfterBurst) {
+  const auto key = opencensus::tags::TagKey::Register("key");
+  DeltaTable table;
+  const size_t initial_capacity = table.capacity();
+  bool inserted;
+  for (int i = 0; i < 1000; ++i) {
+    table.FindOrInsert(opencensus::tags::TagMap({{key, absl::StrCat(i)}}),
+                       &inserted);
+  }
+  const size_t peak_capacity = table.capacity();
+  EXPECT_LE(2000, peak_capacity);
+  table.clear();
+
+  // The table keeps its capacity until a whole window of clears that does not
+  // include the burst has stayed small.
+  for (int harvest = 0; harvest < 7; ++harvest) {
+    EXPECT_EQ(peak_capacity, table.capacity());
+    table.FindOrInsert(opencensus::tags::TagMap({{key, "value1"}}), &inserted);
+    EXPECT_TRUE(inserted);
+    table.FindOrInsert(opencensus::tags::TagMap({{key, "value2"}}), &inserted);
+    table.clear();
+  }
+  EXPECT_EQ(initial_capacity, table.capacity());
+
+  // The shrunk table still works, and recycles the rows it kept.
+  table.FindOrInsert(opencensus::tags::TagMap({{key, "value1"}}), &inserted);
+  EXPECT_TRUE(inserted);
+  EXPECT_NE(nullptr, table.Find(opencensus::tags::TagMap({{key, "value1"}})));
+  EXPECT_EQ(nullptr, table.Find(opencensus::tags::TagMap({{key, "value2"}})));
+  EXPECT_EQ(1, table.size());
+}
+
+TEST(DeltaTableTest, FindEntry) {
+  DeltaTable::Row row;
+  EXPECT_EQ(nullptr, DeltaTable::FindEntry(row, 0));
+  row.push_back(DeltaTable::Entry{
+      7, MeasureData(absl::Span<const BucketBoundaries>())});
+  row.push_back(DeltaTable::Entry{
+      3, MeasureData(absl::Span<const BucketBoundaries>())});
+  EXPECT_EQ(&row[0], DeltaTable::FindEntry(row, 7));
+  EXPECT_EQ(&row[1], DeltaTable::FindEntry(&row, 3));
+  EXPECT_EQ(nullptr, DeltaTable::FindEntry(row, 0));
+}
+
+}  // namespace
+}  // namespace stats
+}  // namespace opencensus
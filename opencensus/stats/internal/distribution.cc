@@ -15,6 +15,9 @@
 #include "opencensus/stats/distribution.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
@@ -23,7 +26,8 @@ namespace opencensus {
 namespace stats {
 
 Distribution::Distribution(const BucketBoundaries* buckets)
-    : buckets_(buckets), bucket_counts_(buckets->num_buckets()) {}
+    : buckets_(buckets),
+      bucket_counts_(buckets->auto_ranging() ? 0 : buckets->num_buckets()) {}
 
 void Distribution::Add(double value) {
   // Update using the method of provisional means.
@@ -37,14 +41,112 @@ void Distribution::Add(double value) {
   min_ = std::min(value, min_);
   max_ = std::max(value, max_);
 
-  ++bucket_counts_[buckets_->BucketForValue(value)];
+  const int bucket = buckets_->BucketForValue(value);
+  if (buckets_->auto_ranging()) {
+    ExtendBuckets(bucket, bucket + 1);
+  }
+  ++bucket_counts_[bucket - bucket_offset_];
+}
+
+void Distribution::ExtendBuckets(int begin, int end) {
+  ABSL_ASSERT(buckets_->auto_ranging() && begin < end);
+  if (bucket_counts_.empty()) {
+    bucket_offset_ = begin;
+    bucket_counts_.resize(end - begin);
+    return;
+  }
+  if (begin < bucket_offset_) {
+    bucket_counts_.insert(bucket_counts_.begin(), bucket_offset_ - begin, 0);
+    bucket_offset_ = begin;
+  }
+  if (end > bucket_offset_ + static_cast<int>(bucket_counts_.size())) {
+    bucket_counts_.resize(end - bucket_offset_);
+  }
+}
+
+void Distribution::TrimBuckets() {
+  ABSL_ASSERT(buckets_->auto_ranging());
+  const auto first = std::find_if(bucket_counts_.begin(), bucket_counts_.end(),
+                                  [](uint64_t count) { return count != 0; });
+  if (first == bucket_counts_.end()) {
+    bucket_counts_.clear();
+    bucket_offset_ = 0;
+    return;
+  }
+  const auto last =
+      std::find_if(bucket_counts_.rbegin(), bucket_counts_.rend(),
+                   [](uint64_t count) { return count != 0; });
+  bucket_counts_.erase(last.base(), bucket_counts_.end());
+  bucket_offset_ += first - bucket_counts_.begin();
+  bucket_counts_.erase(bucket_counts_.begin(), first);
+}
+
+void Distribution::CollapseBuckets(int max_buckets) {
+  ABSL_ASSERT(buckets_->auto_ranging() && max_buckets > 0);
+  const int excess = static_cast<int>(bucket_counts_.size()) - max_buckets;
+  if (excess <= 0) {
+    return;
+  }
+  for (int i = 0; i < excess; ++i) {
+    bucket_counts_[excess] += bucket_counts_[i];
+  }
+  bucket_counts_.erase(bucket_counts_.begin(), bucket_counts_.begin() + excess);
+  bucket_offset_ += excess;
+}
+
+double Distribution::Quantile(double quantile) const {
+  if (count_ == 0) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  if (bucket_counts_.empty()) {
+    // Interval distributions may round away the bucket counts.
+    return mean_;
+  }
+  // The rank, counting from 0, of the value to estimate.
+  const double rank =
+      std::min(std::max(quantile, 0.0), 1.0) * (count_ - 1);
+  // The extremes are known exactly.
+  if (rank <= 0) {
+    return min_;
+  }
+  if (rank >= count_ - 1) {
+    return max_;
+  }
+  uint64_t preceding = 0;
+  int i = 0;
+  while (i + 1 < bucket_counts_.size() &&
+         preceding + bucket_counts_[i] <= rank) {
+    preceding += bucket_counts_[i];
+    ++i;
+  }
+  const int bucket = bucket_offset_ + i;
+  const std::vector<double>& boundaries = buckets_->lower_boundaries();
+  // The underflow and overflow buckets are bounded by the range of values, as
+  // is the first counted bucket, into which CollapseBuckets() may have merged
+  // lower buckets.
+  const double lower = i > 0 ? std::max(boundaries[bucket - 1], min_) : min_;
+  const double upper =
+      bucket < boundaries.size() ? std::min(boundaries[bucket], max_) : max_;
+  if (!(lower < upper)) {
+    return lower;
+  }
+  if (buckets_->auto_ranging() && lower > 0) {
+    // Equidistant from both bounds in relative terms.
+    return 2 * lower * upper / (lower + upper);
+  }
+  const double fraction =
+      (rank - preceding + 0.5) / std::max<uint64_t>(bucket_counts_[i], 1);
+  return lower + (upper - lower) * std::min(fraction, 1.0);
 }
 
 std::string Distribution::DebugString() const {
   return absl::StrCat("count: ", count_, " mean: ", mean_,
                       " sum of squared deviation: ", sum_of_squared_deviation_,
-                      " min: ", min_, " max: ", max_, "\nhistogram counts: ",
-                      absl::StrJoin(bucket_counts_, ", "));
+                      " min: ", min_, " max: ", max_, "\nhistogram counts",
+                      bucket_offset_ == 0
+                          ? ""
+                          : absl::StrCat(" from bucket ", bucket_offset_),
+                      ": ", absl::StrJoin(bucket_counts_, ", "));
 }
 
 }  // namespace stats
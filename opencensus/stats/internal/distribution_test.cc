@@ -50,6 +50,63 @@ TEST(DistributionTest, Bucketing) {
   EXPECT_EQ(distribution.bucket_counts(), std::vector<uint64_t>({1, 2, 2}));
 }
 
+TEST(DistributionTest, AutoRangingBuckets) {
+  BucketBoundaries buckets = BucketBoundaries::LogLinear(1);
+  Distribution distribution = testing::TestUtils::MakeDistribution(&buckets);
+  EXPECT_TRUE(distribution.bucket_counts().empty());
+
+  testing::TestUtils::AddToDistribution(&distribution, 4);
+  const int bucket = buckets.BucketForValue(4);
+  EXPECT_EQ(bucket, distribution.bucket_offset());
+  EXPECT_EQ(distribution.bucket_counts(), std::vector<uint64_t>({1}));
+
+  // [6, 8) and [8, 12) are the next buckets.
+  testing::TestUtils::AddToDistribution(&distribution, 9);
+  EXPECT_EQ(bucket, distribution.bucket_offset());
+  EXPECT_EQ(distribution.bucket_counts(), std::vector<uint64_t>({1, 0, 1}));
+
+  testing::TestUtils::AddToDistribution(&distribution, 3);
+  EXPECT_EQ(bucket - 1, distribution.bucket_offset());
+  EXPECT_EQ(distribution.bucket_counts(),
+            std::vector<uint64_t>({1, 1, 0, 1}));
+}
+
+TEST(DistributionTest, Quantile) {
+  BucketBoundaries buckets = BucketBoundaries::Explicit({10, 20});
+  Distribution distribution = testing::TestUtils::MakeDistribution(&buckets);
+  EXPECT_TRUE(std::isnan(distribution.Quantile(0.5)));
+
+  for (int i = 0; i < 10; ++i) {
+    testing::TestUtils::AddToDistribution(&distribution, 10 + i);
+  }
+  testing::TestUtils::AddToDistribution(&distribution, 5);
+  testing::TestUtils::AddToDistribution(&distribution, 30);
+  // Interpolated within [10, 20).
+  EXPECT_DOUBLE_EQ(15, distribution.Quantile(0.5));
+  EXPECT_DOUBLE_EQ(10.5, distribution.Quantile(1.0 / 11));
+  // The underflow and overflow buckets are bounded by min and max, which are
+  // the extreme quantiles.
+  EXPECT_DOUBLE_EQ(5, distribution.Quantile(0));
+  EXPECT_DOUBLE_EQ(30, distribution.Quantile(1));
+}
+
+TEST(DistributionTest, AutoRangingQuantileRelativeError) {
+  const int precision = 3;
+  BucketBoundaries buckets = BucketBoundaries::LogLinear(precision);
+  Distribution distribution = testing::TestUtils::MakeDistribution(&buckets);
+  std::vector<double> values;
+  for (int i = 0; i < 1000; ++i) {
+    values.push_back(std::exp(i * 0.013) * 0.1);
+    testing::TestUtils::AddToDistribution(&distribution, values.back());
+  }
+  for (const double quantile : {0.0, 0.25, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+    const double expected = values[static_cast<int>(quantile * 999)];
+    EXPECT_NEAR(expected, distribution.Quantile(quantile),
+                expected * std::ldexp(1, -(precision + 1)))
+        << quantile;
+  }
+}
+
 TEST(DistributionTest, SmallSequence) {
   BucketBoundaries buckets = BucketBoundaries::Explicit({});
   Distribution distribution = testing::TestUtils::MakeDistribution(&buckets);
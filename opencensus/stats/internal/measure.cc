@@ -14,9 +14,14 @@
 
 #include "opencensus/stats/measure.h"
 
+#include <memory>
+#include <utility>
+
 #include "absl/strings/string_view.h"
+#include "opencensus/stats/internal/delta_producer.h"
 #include "opencensus/stats/internal/measure_registry_impl.h"
 #include "opencensus/stats/measure_registry.h"
+#include "opencensus/tags/tag_map.h"
 
 namespace opencensus {
 namespace stats {
@@ -50,11 +55,31 @@ bool MeasureInt64::IsValid() const {
          MeasureRegistryImpl::IdToType(id_) == MeasureDescriptor::Type::kInt64;
 }
 
+template <typename MeasureT>
+BoundMeasure<MeasureT> Measure<MeasureT>::Bind(
+    opencensus::tags::TagMap tags) const {
+  if (!IsValid()) {
+    return BoundMeasure<MeasureT>(nullptr);
+  }
+  // Interning makes the delta lookup on every harvest a pointer comparison.
+  return BoundMeasure<MeasureT>(DeltaProducer::Get()->AddBoundMeasureCell(
+      MeasureRegistryImpl::IdToIndex(id_), tags.Intern()));
+}
+
 template <typename MeasureT>
 Measure<MeasureT>::Measure(uint64_t id) : id_(id) {}
 
+template <typename MeasureT>
+void BoundMeasure<MeasureT>::Record(MeasureT value) const {
+  if (cell_ != nullptr) {
+    cell_->Add(value);
+  }
+}
+
 template class Measure<double>;
 template class Measure<int64_t>;
+template class BoundMeasure<double>;
+template class BoundMeasure<int64_t>;
 
 }  // namespace stats
 }  // namespace opencensus
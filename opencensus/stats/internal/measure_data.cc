@@ -18,18 +18,184 @@
 #include <cmath>
 #include <cstdint>
 #include <iostream>
+#include <limits>
+#include <utility>
 #include <vector>
 
 #include "absl/base/macros.h"
 #include "absl/types/span.h"
+#include "opencensus/stats/aggregation.h"
 #include "opencensus/stats/bucket_boundaries.h"
 #include "opencensus/stats/distribution.h"
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define OPENCENSUS_MEASURE_DATA_X86 1
+#include <emmintrin.h>
+#endif
+
 namespace opencensus {
 namespace stats {
 
-MeasureData::MeasureData(absl::Span<const BucketBoundaries> boundaries)
-    : boundaries_(boundaries) {
+namespace {
+
+// Returns the smaller and larger of 'value' and 'bound', ignoring a NaN 'value'
+// as _mm_min_pd(value, bound) and _mm_max_pd(value, bound) do, so that Add()
+// and AddBatch() agree.
+double MinIgnoringNaN(double value, double bound) {
+  return value < bound ? value : bound;
+}
+double MaxIgnoringNaN(double value, double bound) {
+  return value > bound ? value : bound;
+}
+
+struct SumMinMax {
+  double sum;
+  double min;
+  double max;
+};
+
+// Returns the sum, minimum and maximum of 'values'. NaN values are included in
+// the sum but not in the minimum and maximum.
+SumMinMax ReduceSumMinMax(absl::Span<const double> values) {
+  SumMinMax result = {0, std::numeric_limits<double>::infinity(),
+                      -std::numeric_limits<double>::infinity()};
+  size_t i = 0;
+#ifdef OPENCENSUS_MEASURE_DATA_X86
+  // SSE2 is part of the x86-64 baseline. Two accumulators shorten the
+  // dependency chains.
+  __m128d sum1 = _mm_setzero_pd();
+  __m128d sum2 = _mm_setzero_pd();
+  __m128d min1 = _mm_set1_pd(result.min);
+  __m128d min2 = min1;
+  __m128d max1 = _mm_set1_pd(result.max);
+  __m128d max2 = max1;
+  for (; i + 4 <= values.size(); i += 4) {
+    const __m128d v1 = _mm_loadu_pd(values.data() + i);
+    const __m128d v2 = _mm_loadu_pd(values.data() + i + 2);
+    sum1 = _mm_add_pd(sum1, v1);
+    sum2 = _mm_add_pd(sum2, v2);
+    // These return their second operand if either is NaN, so NaN lanes keep
+    // the running bounds.
+    min1 = _mm_min_pd(v1, min1);
+    min2 = _mm_min_pd(v2, min2);
+    max1 = _mm_max_pd(v1, max1);
+    max2 = _mm_max_pd(v2, max2);
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(sum1, sum2));
+  result.sum = lanes[0] + lanes[1];
+  _mm_storeu_pd(lanes, _mm_min_pd(min1, min2));
+  result.min = std::min(lanes[0], lanes[1]);
+  _mm_storeu_pd(lanes, _mm_max_pd(max1, max2));
+  result.max = std::max(lanes[0], lanes[1]);
+#endif
+  for (; i < values.size(); ++i) {
+    result.sum += values[i];
+    result.min = MinIgnoringNaN(values[i], result.min);
+    result.max = MaxIgnoringNaN(values[i], result.max);
+  }
+  return result;
+}
+
+// Returns the sum of squared deviations of 'values' from 'mean'.
+double ReduceSumOfSquaredDeviation(absl::Span<const double> values,
+                                   double mean) {
+  double result = 0;
+  size_t i = 0;
+#ifdef OPENCENSUS_MEASURE_DATA_X86
+  const __m128d means = _mm_set1_pd(mean);
+  __m128d sum1 = _mm_setzero_pd();
+  __m128d sum2 = _mm_setzero_pd();
+  for (; i + 4 <= values.size(); i += 4) {
+    const __m128d d1 = _mm_sub_pd(_mm_loadu_pd(values.data() + i), means);
+    const __m128d d2 = _mm_sub_pd(_mm_loadu_pd(values.data() + i + 2), means);
+    sum1 = _mm_add_pd(sum1, _mm_mul_pd(d1, d1));
+    sum2 = _mm_add_pd(sum2, _mm_mul_pd(d2, d2));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(sum1, sum2));
+  result = lanes[0] + lanes[1];
+#endif
+  for (; i < values.size(); ++i) {
+    result += (values[i] - mean) * (values[i] - mean);
+  }
+  return result;
+}
+
+// AddBatch() tallies the buckets of histograms with up to this many buckets
+// on the stack before adding them to the histogram.
+constexpr int kMaxTalliedBuckets = 256;
+// AddBatch() buckets values for larger histograms this many at a time.
+constexpr size_t kBucketBlockSize = 64;
+
+// Adds each of 'values' to 'histogram', which uses 'boundaries'.
+void AddBatchToHistogram(const BucketBoundaries& boundaries,
+                         absl::Span<const double> values,
+                         CompactHistogram* histogram) {
+  const int num_buckets = boundaries.num_buckets();
+  if (num_buckets <= kMaxTalliedBuckets) {
+    uint64_t counts[kMaxTalliedBuckets];
+    std::fill(counts, counts + num_buckets, 0);
+    for (const double value : values) {
+      ++counts[boundaries.BucketForValue(value)];
+    }
+    for (int bucket = 0; bucket < num_buckets; ++bucket) {
+      if (counts[bucket] != 0) {
+        histogram->Add(bucket, counts[bucket]);
+      }
+    }
+    return;
+  }
+  int buckets[kBucketBlockSize];
+  for (size_t start = 0; start < values.size(); start += kBucketBlockSize) {
+    const size_t size = std::min(kBucketBlockSize, values.size() - start);
+    for (size_t j = 0; j < size; ++j) {
+      buckets[j] = boundaries.BucketForValue(values[start + j]);
+    }
+    // Batches tend to have runs of similar values, which are added at once.
+    for (size_t j = 0; j < size;) {
+      size_t end = j + 1;
+      while (end < size && buckets[end] == buckets[j]) {
+        ++end;
+      }
+      histogram->Add(buckets[j], end - j);
+      j = end;
+    }
+  }
+}
+
+}  // namespace
+
+MeasureData::Statistics MeasureData::StatisticsFor(Aggregation::Type type) {
+  switch (type) {
+    case Aggregation::Type::kCount:
+      return Statistics::kCount;
+    case Aggregation::Type::kSum:
+      return Statistics::kSum;
+    case Aggregation::Type::kLastValue:
+      return Statistics::kLastValue;
+    case Aggregation::Type::kDistribution:
+      return Statistics::kAll;
+  }
+  return Statistics::kAll;
+}
+
+MeasureData::Statistics MeasureData::Union(Statistics a, Statistics b) {
+  if (a == b || b == Statistics::kCount) {
+    return a;
+  }
+  if (a == Statistics::kCount) {
+    return b;
+  }
+  return Statistics::kAll;
+}
+
+MeasureData::MeasureData(absl::Span<const BucketBoundaries> boundaries,
+                         Statistics statistics)
+    : boundaries_(boundaries), statistics_(statistics) {
+  if (statistics_ != Statistics::kAll) {
+    return;
+  }
   histograms_.reserve(boundaries_.size());
   for (const auto& b : boundaries_) {
     histograms_.emplace_back(b.num_buckets());
@@ -37,29 +203,193 @@ MeasureData::MeasureData(absl::Span<const BucketBoundaries> boundaries)
 }
 
 void MeasureData::Add(double value) {
-  last_value_ = value;
-  // Update using the method of provisional means.
+  switch (statistics_) {
+    case Statistics::kCount:
+      AddValue<Statistics::kCount>(value);
+      return;
+    case Statistics::kSum:
+      AddValue<Statistics::kSum>(value);
+      return;
+    case Statistics::kLastValue:
+      AddValue<Statistics::kLastValue>(value);
+      return;
+    case Statistics::kAll:
+      AddValue<Statistics::kAll>(value);
+      return;
+  }
+}
+
+template <MeasureData::Statistics kStatistics>
+void MeasureData::AddValue(double value) {
   ++count_;
   ABSL_ASSERT(count_ > 0 && "Histogram count overflow.");
+  switch (kStatistics) {
+    case Statistics::kCount:
+      return;
+    case Statistics::kSum:
+      sum_ += value;
+      return;
+    case Statistics::kLastValue:
+      last_value_ = value;
+      return;
+    case Statistics::kAll:
+      break;
+  }
+
+  last_value_ = value;
+  // Update using the method of provisional means.
   const double old_mean = mean_;
   mean_ += (value - mean_) / count_;
   sum_of_squared_deviation_ =
       sum_of_squared_deviation_ + (value - old_mean) * (value - mean_);
 
-  min_ = std::min(value, min_);
-  max_ = std::max(value, max_);
+  min_ = MinIgnoringNaN(value, min_);
+  max_ = MaxIgnoringNaN(value, max_);
 
   for (int i = 0; i < boundaries_.size(); ++i) {
-    ++histograms_[i][boundaries_[i].BucketForValue(value)];
+    histograms_[i].Add(boundaries_[i].BucketForValue(value));
+  }
+}
+
+void MeasureData::AddBatch(absl::Span<const double> values) {
+  if (values.empty()) {
+    return;
+  }
+  switch (statistics_) {
+    case Statistics::kCount:
+      AddValues<Statistics::kCount>(values);
+      return;
+    case Statistics::kSum:
+      AddValues<Statistics::kSum>(values);
+      return;
+    case Statistics::kLastValue:
+      AddValues<Statistics::kLastValue>(values);
+      return;
+    case Statistics::kAll:
+      AddValues<Statistics::kAll>(values);
+      return;
   }
 }
 
+template <MeasureData::Statistics kStatistics>
+void MeasureData::AddValues(absl::Span<const double> values) {
+  const uint64_t new_count = count_ + values.size();
+  ABSL_ASSERT(new_count > count_ && "Histogram count overflow.");
+  switch (kStatistics) {
+    case Statistics::kCount:
+      count_ = new_count;
+      return;
+    case Statistics::kSum:
+      count_ = new_count;
+      sum_ += ReduceSumMinMax(values).sum;
+      return;
+    case Statistics::kLastValue:
+      count_ = new_count;
+      last_value_ = values.back();
+      return;
+    case Statistics::kAll:
+      break;
+  }
+
+  last_value_ = values.back();
+  // Computes the batch's statistics in two passes, which is more accurate than
+  // summing squares, and combines them using the parallel algorithm.
+  const SumMinMax reduced = ReduceSumMinMax(values);
+  const double batch_mean = reduced.sum / values.size();
+  const double batch_sum_of_squared_deviation =
+      ReduceSumOfSquaredDeviation(values, batch_mean);
+  const double delta = batch_mean - mean_;
+  sum_of_squared_deviation_ += batch_sum_of_squared_deviation +
+                               delta * delta * count_ / new_count *
+                                   values.size();
+  mean_ += delta * values.size() / new_count;
+  count_ = new_count;
+  min_ = std::min(reduced.min, min_);
+  max_ = std::max(reduced.max, max_);
+
+  for (int i = 0; i < boundaries_.size(); ++i) {
+    AddBatchToHistogram(boundaries_[i], values, &histograms_[i]);
+  }
+}
+
+void MeasureData::Reset() {
+  last_value_ = std::numeric_limits<double>::quiet_NaN();
+  count_ = 0;
+  sum_ = 0;
+  mean_ = 0;
+  sum_of_squared_deviation_ = 0;
+  min_ = std::numeric_limits<double>::infinity();
+  max_ = -std::numeric_limits<double>::infinity();
+  for (auto& histogram : histograms_) {
+    histogram.Reset();
+  }
+}
+
+void MeasureData::Merge(const MeasureData& other) {
+  if (Union(statistics_, other.statistics_) != other.statistics_) {
+    std::cerr << "Merging MeasureData lacking needed statistics\n";
+    ABSL_ASSERT(false);
+    return;
+  }
+  if (other.count_ == 0) {
+    return;
+  }
+  switch (statistics_) {
+    case Statistics::kCount:
+      count_ += other.count_;
+      return;
+    case Statistics::kSum:
+      count_ += other.count_;
+      sum_ += other.sum();
+      return;
+    case Statistics::kLastValue:
+      count_ += other.count_;
+      last_value_ = other.last_value_;
+      return;
+    case Statistics::kAll:
+      break;
+  }
+  ABSL_ASSERT(histograms_.size() == other.histograms_.size());
+  last_value_ = other.last_value_;
+  // This uses the method of provisional means generalized for multiple values
+  // in both datasets, as in AddToDistribution().
+  const uint64_t new_count = count_ + other.count_;
+  const double new_mean =
+      mean_ + (other.mean_ - mean_) * other.count_ / new_count;
+  sum_of_squared_deviation_ += other.sum_of_squared_deviation_ +
+                               count_ * std::pow(mean_, 2) +
+                               other.count_ * std::pow(other.mean_, 2) -
+                               new_count * std::pow(new_mean, 2);
+  count_ = new_count;
+  mean_ = new_mean;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+  for (int i = 0; i < histograms_.size(); ++i) {
+    histograms_[i].Merge(other.histograms_[i]);
+  }
+}
+
+std::pair<int, int> MeasureData::bucket_range(
+    const BucketBoundaries& boundaries) const {
+  const CompactHistogram* histogram = FindHistogram(boundaries);
+  // Without a histogram, AddToDistribution() adds to the underflow bucket.
+  return histogram == nullptr ? std::make_pair(0, 1)
+                              : histogram->bucket_range();
+}
+
 void MeasureData::AddToDistribution(Distribution* distribution) const {
-  AddToDistribution(distribution->bucket_boundaries(), &distribution->count_,
-                    &distribution->mean_,
+  const BucketBoundaries& boundaries = distribution->bucket_boundaries();
+  if (boundaries.auto_ranging()) {
+    const std::pair<int, int> range = bucket_range(boundaries);
+    if (range.first < range.second) {
+      distribution->ExtendBuckets(range.first, range.second);
+    }
+  }
+  AddToDistribution(boundaries, &distribution->count_, &distribution->mean_,
                     &distribution->sum_of_squared_deviation_,
                     &distribution->min_, &distribution->max_,
-                    absl::Span<uint64_t>(distribution->bucket_counts_));
+                    absl::Span<uint64_t>(distribution->bucket_counts_),
+                    distribution->bucket_offset_);
 }
 
 template <typename T>
@@ -67,7 +397,10 @@ void MeasureData::AddToDistribution(const BucketBoundaries& boundaries,
                                     T* count, double* mean,
                                     double* sum_of_squared_deviation,
                                     double* min, double* max,
-                                    absl::Span<T> histogram_buckets) const {
+                                    absl::Span<T> histogram_buckets,
+                                    int first_bucket) const {
+  ABSL_ASSERT(statistics_ == Statistics::kAll &&
+              "AddToDistribution() requires all statistics.");
   // This uses the method of provisional means generalized for multiple values
   // in both datasets.
   const double new_count = *count + count_;
@@ -87,25 +420,30 @@ void MeasureData::AddToDistribution(const BucketBoundaries& boundaries,
     *max = std::max(*max, max_);
   }
 
-  int histogram_index =
-      std::find(boundaries_.begin(), boundaries_.end(), boundaries) -
-      boundaries_.begin();
-  if (histogram_index >= histograms_.size()) {
+  const CompactHistogram* histogram = FindHistogram(boundaries);
+  if (histogram == nullptr) {
     std::cerr << "No matching BucketBoundaries in AddToDistribution\n";
     ABSL_ASSERT(false);
     // Add to the underflow bucket, to avoid downstream errors from the sum of
     // bucket counts not matching the total count.
     histogram_buckets[0] += count_;
   } else {
-    for (int i = 0; i < histograms_[histogram_index].size(); ++i) {
-      histogram_buckets[i] += histograms_[histogram_index][i];
-    }
+    histogram->AddTo(histogram_buckets, first_bucket);
   }
 }
 
 template void MeasureData::AddToDistribution(const BucketBoundaries&, double*,
                                              double*, double*, double*, double*,
-                                             absl::Span<double>) const;
+                                             absl::Span<double>, int) const;
+
+const CompactHistogram* MeasureData::FindHistogram(
+    const BucketBoundaries& boundaries) const {
+  const int histogram_index =
+      std::find(boundaries_.begin(), boundaries_.end(), boundaries) -
+      boundaries_.begin();
+  return histogram_index < histograms_.size() ? &histograms_[histogram_index]
+                                              : nullptr;
+}
 
 }  // namespace stats
 }  // namespace opencensus
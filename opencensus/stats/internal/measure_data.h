@@ -17,57 +17,123 @@
 
 #include <cstdint>
 #include <limits>
+#include <utility>
 #include <vector>
 
 #include "absl/types/span.h"
+#include "opencensus/stats/aggregation.h"
 #include "opencensus/stats/bucket_boundaries.h"
 #include "opencensus/stats/distribution.h"
+#include "opencensus/stats/internal/compact_histogram.h"
 
 namespace opencensus {
 namespace stats {
 
 // MeasureData tracks all aggregations for a single measure, including
-// histograms for a number of different BucketBoundaries.
+// histograms for a number of different BucketBoundaries. Histograms allocate
+// storage only for the buckets that are populated. Only the statistics that
+// the measure's views need are maintained, using an Add() kernel specialized
+// for them.
 //
 // MeasureData is thread-compatible.
 class MeasureData final {
  public:
-  MeasureData(absl::Span<const BucketBoundaries> boundaries);
+  // The statistics a MeasureData maintains. All include count().
+  enum class Statistics {
+    // count() only.
+    kCount,
+    // count() and sum().
+    kSum,
+    // count() and last_value().
+    kLastValue,
+    // All statistics and histograms, as needed by AddToDistribution().
+    kAll,
+  };
 
+  // Returns the statistics needed by a view with aggregation 'type'.
+  static Statistics StatisticsFor(Aggregation::Type type);
+  // Returns the smallest statistics including both 'a' and 'b'.
+  static Statistics Union(Statistics a, Statistics b);
+
+  // Histograms are only kept if 'statistics' is kAll.
+  MeasureData(absl::Span<const BucketBoundaries> boundaries,
+              Statistics statistics = Statistics::kAll);
+
+  // NaN values are counted, but do not affect the minimum and maximum.
   void Add(double value);
 
+  // Equivalent to calling Add() for each of 'values' in order, up to rounding,
+  // but much faster for many values: the statistics are computed with SIMD
+  // reductions rather than a division per value, and histograms are updated in
+  // blocks.
+  void AddBatch(absl::Span<const double> values);
+
+  // Resets this to its state on construction, keeping histogram storage for
+  // reuse.
+  void Reset();
+
+  // Adds all values in 'other' to this. Requires that 'other' was constructed
+  // with the same boundaries as this, and with statistics that include this's.
+  void Merge(const MeasureData& other);
+
+  Statistics statistics() const { return statistics_; }
+
+  // Require statistics that include them.
   double last_value() const { return last_value_; }
   uint64_t count() const { return count_; }
-  double sum() const { return count_ * mean_; }
+  double sum() const {
+    return statistics_ == Statistics::kSum ? sum_ : count_ * mean_;
+  }
+
+  // Returns [begin, end) covering the buckets of 'boundaries' that
+  // AddToDistribution() adds to, with begin == end if there are none.
+  std::pair<int, int> bucket_range(const BucketBoundaries& boundaries) const;
 
-  // Adds this to 'distribution'. Requires that
+  // Adds this to 'distribution'. Requires statistics kAll, and that
   // distribution->bucket_boundaries() be in the set of boundaries passed to
   // this on construction.
   void AddToDistribution(Distribution* distribution) const;
 
   // Adds this to a distribution by pointers to individual elements.
+  // histogram_buckets holds the counts of consecutive buckets starting with
+  // 'first_bucket', and must cover all buckets populated here.
   template <typename T>
   void AddToDistribution(const BucketBoundaries& boundaries, T* count,
                          double* mean, double* sum_of_squared_deviation,
                          double* min, double* max,
-                         absl::Span<T> histogram_buckets) const;
+                         absl::Span<T> histogram_buckets,
+                         int first_bucket = 0) const;
 
  private:
+  // The kernels of Add() and AddBatch() for each statistics.
+  template <Statistics kStatistics>
+  void AddValue(double value);
+  template <Statistics kStatistics>
+  void AddValues(absl::Span<const double> values);
+
+  // Returns the histogram for 'boundaries', or null if there is none.
+  const CompactHistogram* FindHistogram(
+      const BucketBoundaries& boundaries) const;
+
   const absl::Span<const BucketBoundaries> boundaries_;
+  const Statistics statistics_;
 
   double last_value_ = std::numeric_limits<double>::quiet_NaN();
   uint64_t count_ = 0;
+  // Only maintained for kSum; kAll derives the sum from mean_.
+  double sum_ = 0;
   double mean_ = 0;
   double sum_of_squared_deviation_ = 0;
   double min_ = std::numeric_limits<double>::infinity();
   double max_ = -std::numeric_limits<double>::infinity();
-  std::vector<std::vector<int64_t>> histograms_;
+  std::vector<CompactHistogram> histograms_;
 };
 
 extern template void MeasureData::AddToDistribution(const BucketBoundaries&,
                                                     double*, double*, double*,
                                                     double*, double*,
-                                                    absl::Span<double>) const;
+                                                    absl::Span<double>,
+                                                    int) const;
 
 }  // namespace stats
 }  // namespace opencensus
@@ -0,0 +1,100 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <random>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "benchmark/benchmark.h"
+#include "opencensus/stats/bucket_boundaries.h"
+#include "opencensus/stats/distribution.h"
+#include "opencensus/stats/internal/measure_data.h"
+#include "opencensus/stats/testing/test_utils.h"
+
+namespace opencensus {
+namespace stats {
+namespace {
+
+std::vector<double> RandomValues(int size) {
+  std::mt19937 gen(0);
+  std::lognormal_distribution<double> distribution(3, 1);
+  std::vector<double> values(size);
+  for (auto& value : values) {
+    value = distribution(gen);
+  }
+  return values;
+}
+
+const std::vector<BucketBoundaries>& Boundaries() {
+  static const auto* const boundaries = new std::vector<BucketBoundaries>(
+      {BucketBoundaries::Exponential(20, 1, 1.5)});
+  return *boundaries;
+}
+
+void BM_Add(benchmark::State& state) {
+  const std::vector<double> values = RandomValues(state.range(0));
+  MeasureData data(Boundaries());
+  for (auto _ : state) {
+    for (const double value : values) {
+      data.Add(value);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_Add)->Arg(16)->Arg(1024);
+
+// Adds values maintaining only the statistics given by range(0).
+void BM_AddStatistics(benchmark::State& state) {
+  const std::vector<double> values = RandomValues(1024);
+  MeasureData data(Boundaries(),
+                   static_cast<MeasureData::Statistics>(state.range(0)));
+  for (auto _ : state) {
+    for (const double value : values) {
+      data.Add(value);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_AddStatistics)
+    ->Arg(static_cast<int>(MeasureData::Statistics::kCount))
+    ->Arg(static_cast<int>(MeasureData::Statistics::kSum))
+    ->Arg(static_cast<int>(MeasureData::Statistics::kLastValue))
+    ->Arg(static_cast<int>(MeasureData::Statistics::kAll));
+
+void BM_AddBatch(benchmark::State& state) {
+  const std::vector<double> values = RandomValues(state.range(0));
+  MeasureData data(Boundaries());
+  for (auto _ : state) {
+    data.AddBatch(values);
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_AddBatch)->Arg(16)->Arg(1024);
+
+void BM_AddToDistribution(benchmark::State& state) {
+  const BucketBoundaries boundaries = BucketBoundaries::LogLinear(4);
+  MeasureData data(absl::MakeSpan(&boundaries, 1));
+  data.AddBatch(RandomValues(4096));
+  Distribution distribution = testing::TestUtils::MakeDistribution(&boundaries);
+  for (auto _ : state) {
+    data.AddToDistribution(&distribution);
+  }
+}
+BENCHMARK(BM_AddToDistribution);
+
+}  // namespace
+}  // namespace stats
+}  // namespace opencensus
+
+BENCHMARK_MAIN();
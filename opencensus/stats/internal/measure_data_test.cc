@@ -16,12 +16,14 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <numeric>
 #include <vector>
 
 #include "absl/types/span.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "opencensus/stats/aggregation.h"
 #include "opencensus/stats/bucket_boundaries.h"
 #include "opencensus/stats/distribution.h"
 #include "opencensus/stats/testing/test_utils.h"
@@ -122,6 +124,255 @@ TEST(MeasureDataTest, BatchedAddToDistribution) {
   }
 }
 
+TEST(MeasureDataTest, AddBatch) {
+  // Tests that adding a batch is equivalent to adding its values one by one.
+  std::vector<BucketBoundaries> buckets = {
+      BucketBoundaries::Exponential(7, 2, 2), BucketBoundaries::Explicit({}),
+      BucketBoundaries::LogLinear(2)};
+  MeasureData actual(buckets);
+  MeasureData expected(buckets);
+  actual.Add(-3);
+  expected.Add(-3);
+  std::vector<double> values;
+  for (int i = 0; i < 301; ++i) {
+    // Includes runs of values in the same bucket.
+    values.push_back((i / 7) * 1.7);
+  }
+  actual.AddBatch(values);
+  actual.AddBatch({});
+  for (const double value : values) {
+    expected.Add(value);
+  }
+  EXPECT_EQ(expected.count(), actual.count());
+  EXPECT_DOUBLE_EQ(expected.sum(), actual.sum());
+  EXPECT_EQ(expected.last_value(), actual.last_value());
+
+  for (const auto& boundaries : buckets) {
+    Distribution actual_distribution =
+        testing::TestUtils::MakeDistribution(&boundaries);
+    actual.AddToDistribution(&actual_distribution);
+    Distribution expected_distribution =
+        testing::TestUtils::MakeDistribution(&boundaries);
+    expected.AddToDistribution(&expected_distribution);
+    EXPECT_DOUBLE_EQ(expected_distribution.mean(), actual_distribution.mean());
+    EXPECT_NEAR(expected_distribution.sum_of_squared_deviation(),
+                actual_distribution.sum_of_squared_deviation(), 1e-6);
+    EXPECT_EQ(expected_distribution.min(), actual_distribution.min());
+    EXPECT_EQ(expected_distribution.max(), actual_distribution.max());
+    EXPECT_EQ(expected_distribution.bucket_offset(),
+              actual_distribution.bucket_offset());
+    EXPECT_THAT(
+        actual_distribution.bucket_counts(),
+        ::testing::ElementsAreArray(expected_distribution.bucket_counts()));
+  }
+}
+
+TEST(MeasureDataTest, AddBatchWithNaN) {
+  // NaN values in the vectorized part of the batch and in its tail are
+  // ignored for the minimum and maximum, as by Add().
+  std::vector<BucketBoundaries> buckets = {BucketBoundaries::Explicit({0})};
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const std::vector<double> values = {nan, 2, -1, nan, 5, nan, 3, nan, nan};
+  for (size_t size = 1; size <= values.size(); ++size) {
+    const auto batch = absl::MakeConstSpan(values).subspan(0, size);
+    MeasureData actual(buckets);
+    actual.AddBatch(batch);
+    MeasureData expected(buckets);
+    for (const double value : batch) {
+      expected.Add(value);
+    }
+    EXPECT_EQ(expected.count(), actual.count());
+    Distribution actual_distribution =
+        testing::TestUtils::MakeDistribution(&buckets[0]);
+    actual.AddToDistribution(&actual_distribution);
+    Distribution expected_distribution =
+        testing::TestUtils::MakeDistribution(&buckets[0]);
+    expected.AddToDistribution(&expected_distribution);
+    EXPECT_EQ(expected_distribution.min(), actual_distribution.min())
+        << "size " << size;
+    EXPECT_EQ(expected_distribution.max(), actual_distribution.max())
+        << "size " << size;
+    EXPECT_THAT(
+        actual_distribution.bucket_counts(),
+        ::testing::ElementsAreArray(expected_distribution.bucket_counts()));
+    if (size >= 3) {
+      EXPECT_EQ(-1, actual_distribution.min());
+    }
+  }
+  MeasureData all_nan(buckets);
+  all_nan.AddBatch({nan, nan, nan, nan, nan});
+  MeasureData data(buckets);
+  data.Merge(all_nan);
+  data.Add(7);
+  Distribution distribution = testing::TestUtils::MakeDistribution(&buckets[0]);
+  data.AddToDistribution(&distribution);
+  EXPECT_EQ(6, distribution.count());
+  EXPECT_EQ(7, distribution.min());
+  EXPECT_EQ(7, distribution.max());
+}
+
+TEST(MeasureDataTest, Merge) {
+  // Tests that merging two MeasureData is equivalent to adding all values to
+  // one.
+  std::vector<BucketBoundaries> buckets = {
+      BucketBoundaries::Exponential(7, 2, 2)};
+  MeasureData data1(buckets);
+  MeasureData data2(buckets);
+  MeasureData expected(buckets);
+  for (int i = 0; i < 100; ++i) {
+    (i % 3 ? data1 : data2).Add(i);
+    expected.Add(i);
+  }
+  data1.Merge(data2);
+
+  Distribution actual_distribution =
+      testing::TestUtils::MakeDistribution(&buckets[0]);
+  data1.AddToDistribution(&actual_distribution);
+  Distribution expected_distribution =
+      testing::TestUtils::MakeDistribution(&buckets[0]);
+  expected.AddToDistribution(&expected_distribution);
+  EXPECT_EQ(expected_distribution.count(), actual_distribution.count());
+  EXPECT_DOUBLE_EQ(expected_distribution.mean(), actual_distribution.mean());
+  EXPECT_NEAR(expected_distribution.sum_of_squared_deviation(),
+              actual_distribution.sum_of_squared_deviation(), 1e-6);
+  EXPECT_DOUBLE_EQ(expected_distribution.min(), actual_distribution.min());
+  EXPECT_DOUBLE_EQ(expected_distribution.max(), actual_distribution.max());
+  EXPECT_THAT(
+      actual_distribution.bucket_counts(),
+      ::testing::ElementsAreArray(expected_distribution.bucket_counts()));
+}
+
+TEST(MeasureDataTest, StatisticsForAggregations) {
+  using Statistics = MeasureData::Statistics;
+  EXPECT_EQ(Statistics::kCount,
+            MeasureData::StatisticsFor(Aggregation::Type::kCount));
+  EXPECT_EQ(Statistics::kSum,
+            MeasureData::StatisticsFor(Aggregation::Type::kSum));
+  EXPECT_EQ(Statistics::kLastValue,
+            MeasureData::StatisticsFor(Aggregation::Type::kLastValue));
+  EXPECT_EQ(Statistics::kAll,
+            MeasureData::StatisticsFor(Aggregation::Type::kDistribution));
+
+  EXPECT_EQ(Statistics::kCount,
+            MeasureData::Union(Statistics::kCount, Statistics::kCount));
+  EXPECT_EQ(Statistics::kSum,
+            MeasureData::Union(Statistics::kCount, Statistics::kSum));
+  EXPECT_EQ(Statistics::kLastValue,
+            MeasureData::Union(Statistics::kLastValue, Statistics::kCount));
+  EXPECT_EQ(Statistics::kAll,
+            MeasureData::Union(Statistics::kSum, Statistics::kLastValue));
+  EXPECT_EQ(Statistics::kAll,
+            MeasureData::Union(Statistics::kAll, Statistics::kSum));
+}
+
+TEST(MeasureDataTest, SpecializedStatistics) {
+  // Each kernel maintains its statistics as the full one does, whether values
+  // are added one at a time, in a batch or by merging.
+  const std::vector<BucketBoundaries> buckets = {
+      BucketBoundaries::Explicit({0, 10})};
+  const std::vector<double> values = {3, -1, 12.5, 4, 8, 0.25, 7};
+  MeasureData expected(buckets);
+  for (const double value : values) {
+    expected.Add(value);
+  }
+  for (const auto statistics :
+       {MeasureData::Statistics::kCount, MeasureData::Statistics::kSum,
+        MeasureData::Statistics::kLastValue}) {
+    SCOPED_TRACE(static_cast<int>(statistics));
+    MeasureData added(buckets, statistics);
+    MeasureData batched(buckets, statistics);
+    MeasureData merged(buckets, statistics);
+    EXPECT_EQ(statistics, added.statistics());
+    for (int i = 0; i < values.size(); ++i) {
+      added.Add(values[i]);
+      if (i == 3) {
+        MeasureData part(buckets, statistics);
+        part.AddBatch(absl::MakeConstSpan(values).subspan(0, 4));
+        merged.Merge(part);
+      }
+    }
+    batched.AddBatch(values);
+    MeasureData part(buckets, statistics);
+    part.AddBatch(absl::MakeConstSpan(values).subspan(4));
+    merged.Merge(part);
+
+    for (const MeasureData* data : {&added, &batched, &merged}) {
+      EXPECT_EQ(expected.count(), data->count());
+      if (statistics == MeasureData::Statistics::kSum) {
+        EXPECT_DOUBLE_EQ(expected.sum(), data->sum());
+      }
+      if (statistics == MeasureData::Statistics::kLastValue) {
+        EXPECT_EQ(expected.last_value(), data->last_value());
+      }
+    }
+
+    added.Reset();
+    EXPECT_EQ(0, added.count());
+    added.Add(2);
+    EXPECT_EQ(1, added.count());
+    if (statistics == MeasureData::Statistics::kSum) {
+      EXPECT_EQ(2, added.sum());
+    }
+  }
+}
+
+TEST(MeasureDataTest, MergeIntoNarrowerStatistics) {
+  const std::vector<BucketBoundaries> buckets = {
+      BucketBoundaries::Explicit({0})};
+  MeasureData all(buckets);
+  all.Add(2);
+  all.Add(5);
+  MeasureData sum(buckets, MeasureData::Statistics::kSum);
+  sum.Add(1);
+  sum.Merge(all);
+  EXPECT_EQ(3, sum.count());
+  EXPECT_DOUBLE_EQ(8, sum.sum());
+  MeasureData last_value(buckets, MeasureData::Statistics::kLastValue);
+  last_value.Merge(all);
+  EXPECT_EQ(2, last_value.count());
+  EXPECT_EQ(5, last_value.last_value());
+}
+
+TEST(MeasureDataDeathTest, MergeLackingStatistics) {
+  const std::vector<BucketBoundaries> buckets = {
+      BucketBoundaries::Explicit({0})};
+  MeasureData all(buckets);
+  MeasureData sum(buckets, MeasureData::Statistics::kSum);
+  sum.Add(1);
+  EXPECT_DEBUG_DEATH(
+      {
+        all.Merge(sum);
+        EXPECT_EQ(0, all.count());
+      },
+      "Merging MeasureData lacking needed statistics");
+}
+
+TEST(MeasureDataTest, AutoRangingDistribution) {
+  std::vector<BucketBoundaries> buckets = {BucketBoundaries::LogLinear(3)};
+  MeasureData data(buckets);
+  Distribution expected_distribution =
+      testing::TestUtils::MakeDistribution(&buckets[0]);
+  // Enough values to use dense counters.
+  for (int i = 1; i < 100; ++i) {
+    data.Add(i * 0.37);
+    testing::TestUtils::AddToDistribution(&expected_distribution, i * 0.37);
+  }
+
+  Distribution actual_distribution =
+      testing::TestUtils::MakeDistribution(&buckets[0]);
+  testing::TestUtils::AddToDistribution(&actual_distribution, 1000);
+  testing::TestUtils::AddToDistribution(&expected_distribution, 1000);
+  data.AddToDistribution(&actual_distribution);
+  EXPECT_EQ(expected_distribution.count(), actual_distribution.count());
+  EXPECT_EQ(buckets[0].BucketForValue(0.37),
+            actual_distribution.bucket_offset());
+  EXPECT_EQ(expected_distribution.bucket_offset(),
+            actual_distribution.bucket_offset());
+  EXPECT_THAT(
+      actual_distribution.bucket_counts(),
+      ::testing::ElementsAreArray(expected_distribution.bucket_counts()));
+}
+
 TEST(MeasureDataDeathTest, AddToDistributionWithUnknownBuckets) {
   BucketBoundaries buckets = BucketBoundaries::Explicit({0, 10});
   MeasureData data(absl::MakeSpan(&buckets, 1));
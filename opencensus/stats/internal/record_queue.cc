@@ -0,0 +1,132 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "opencensus/stats/internal/record_queue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "opencensus/stats/internal/delta_producer.h"
+#include "opencensus/stats/measure.h"
+#include "opencensus/tags/tag_map.h"
+
+namespace opencensus {
+namespace stats {
+
+namespace {
+
+size_t RoundUpToPowerOf2(size_t n) {
+  size_t result = 1;
+  while (result < n) {
+    result <<= 1;
+  }
+  return result;
+}
+
+}  // namespace
+
+constexpr int RecordQueue::kMaxMeasurements;
+
+// This is a bounded queue in the style of Dmitry Vyukov's MPMC queue: each slot
+// carries a sequence number which tells producers and the consumer whether the
+// slot is free for the current lap of enqueue_pos_/dequeue_pos_.
+RecordQueue::RecordQueue(size_t capacity)
+    : mask_(RoundUpToPowerOf2(capacity) - 1),
+      slots_(new Slot[mask_ + 1]),
+      enqueue_pos_(0) {
+  for (size_t i = 0; i <= mask_; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+RecordQueue::~RecordQueue() {
+  absl::MutexLock l(&consumer_mu_);
+  for (size_t pos = dequeue_pos_;; ++pos) {
+    Slot& slot = slots_[pos & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+      break;
+    }
+    reinterpret_cast<opencensus::tags::TagMap*>(&slot.tags)->~TagMap();
+  }
+}
+
+bool RecordQueue::Push(absl::Span<const Measurement> measurements,
+                       const opencensus::tags::TagMap& tags) {
+  if (measurements.size() > kMaxMeasurements) {
+    return false;
+  }
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Slot* slot;
+  while (true) {
+    slot = &slots_[pos & mask_];
+    const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    const intptr_t difference =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (difference == 0) {
+      // The slot is free; try to claim it.
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // The slot still holds a record from the previous lap: the queue is
+      // full.
+      return false;
+    } else {
+      // Another producer claimed the slot first.
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  slot->num_measurements = measurements.size();
+  for (int i = 0; i < measurements.size(); ++i) {
+    new (&slot->measurements[i]) Measurement(measurements[i]);
+  }
+  new (&slot->tags) opencensus::tags::TagMap(tags);
+  // Publish the record to the consumer.
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+size_t RecordQueue::DrainInto(Delta* delta) {
+  absl::MutexLock l(&consumer_mu_);
+  size_t num_records = 0;
+  while (true) {
+    Slot& slot = slots_[dequeue_pos_ & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+      // The next record has not been published yet.
+      break;
+    }
+    opencensus::tags::TagMap* tags =
+        reinterpret_cast<opencensus::tags::TagMap*>(&slot.tags);
+    delta->Record(
+        absl::Span<const Measurement>(
+            reinterpret_cast<const Measurement*>(slot.measurements),
+            slot.num_measurements),
+        *tags);
+    tags->~TagMap();
+    // Release the slot to producers for the next lap.
+    slot.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+    ++dequeue_pos_;
+    ++num_records;
+  }
+  return num_records;
+}
+
+}  // namespace stats
+}  // namespace opencensus
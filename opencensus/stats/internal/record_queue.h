@@ -0,0 +1,89 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OPENCENSUS_STATS_INTERNAL_RECORD_QUEUE_H_
+#define OPENCENSUS_STATS_INTERNAL_RECORD_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "opencensus/stats/measure.h"
+#include "opencensus/tags/tag_map.h"
+
+namespace opencensus {
+namespace stats {
+
+class Delta;
+
+// RecordQueue is a bounded, lock-free, multi-producer queue of Record() calls.
+// Producers never block: Push() fails if the queue is full. Records are
+// aggregated into a Delta by DrainInto(), which is serialized internally so
+// that there is only ever one consumer.
+//
+// RecordQueue is thread-safe.
+class RecordQueue final {
+ public:
+  // The maximum number of measurements in a single queued record. Larger
+  // records must be recorded directly.
+  static constexpr int kMaxMeasurements = 8;
+
+  // Creates a queue holding up to 'capacity' records. 'capacity' is rounded
+  // up to a power of 2.
+  explicit RecordQueue(size_t capacity);
+  ~RecordQueue();
+
+  RecordQueue(const RecordQueue&) = delete;
+  RecordQueue& operator=(const RecordQueue&) = delete;
+
+  // Pushes a record onto the queue and returns true; or returns false if the
+  // queue is full or measurements.size() > kMaxMeasurements.
+  bool Push(absl::Span<const Measurement> measurements,
+            const opencensus::tags::TagMap& tags);
+
+  // Pops every record presently in the queue, recording each into 'delta'.
+  // Returns the number of records popped.
+  size_t DrainInto(Delta* delta) LOCKS_EXCLUDED(consumer_mu_);
+
+ private:
+  // A single queued record. A slot is owned by the producer that claimed it
+  // until it publishes the record by advancing 'sequence', and then by the
+  // consumer until it releases the slot by advancing 'sequence' again.
+  struct Slot {
+    std::atomic<size_t> sequence;
+    int num_measurements;
+    // Storage for the measurements and tags of the record, constructed in
+    // place by Push() and destroyed by DrainInto().
+    typename std::aligned_storage<sizeof(Measurement), alignof(Measurement)>::
+        type measurements[kMaxMeasurements];
+    typename std::aligned_storage<sizeof(opencensus::tags::TagMap),
+                                  alignof(opencensus::tags::TagMap)>::type tags;
+  };
+
+  const size_t mask_;
+  const std::unique_ptr<Slot[]> slots_;
+  std::atomic<size_t> enqueue_pos_;
+
+  absl::Mutex consumer_mu_;
+  size_t dequeue_pos_ GUARDED_BY(consumer_mu_) = 0;
+};
+
+}  // namespace stats
+}  // namespace opencensus
+
+#endif  // OPENCENSUS_STATS_INTERNAL_RECORD_QUEUE_H_
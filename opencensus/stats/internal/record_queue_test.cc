@@ -0,0 +1,130 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "opencensus/stats/internal/record_queue.h"
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "opencensus/stats/bucket_boundaries.h"
+#include "opencensus/stats/internal/delta_producer.h"
+#include "opencensus/stats/internal/measure_registry_impl.h"
+#include "opencensus/stats/measure.h"
+#include "opencensus/tags/tag_key.h"
+#include "opencensus/tags/tag_map.h"
+
+namespace opencensus {
+namespace stats {
+namespace {
+
+MeasureDouble TestMeasure() {
+  static const MeasureDouble measure =
+      MeasureDouble::Register("record_queue_test_measure", "", "");
+  return measure;
+}
+
+// Returns an empty Delta configured for all measures up to TestMeasure().
+Delta MakeDelta() {
+  std::vector<std::vector<BucketBoundaries>> boundaries(
+      MeasureRegistryImpl::MeasureToIndex(TestMeasure()) + 1);
+  Delta delta;
+  Delta unused;
+  delta.SwapAndReset(boundaries, &unused);
+  return delta;
+}
+
+uint64_t CountFor(const Delta& delta, const opencensus::tags::TagMap& tags) {
+  const DeltaTable::Row* row = delta.delta().Find(tags);
+  if (row == nullptr) {
+    return 0;
+  }
+  const DeltaTable::Entry* entry = DeltaTable::FindEntry(
+      *row, MeasureRegistryImpl::MeasureToIndex(TestMeasure()));
+  return entry == nullptr ? 0 : entry->data.count();
+}
+
+TEST(RecordQueueTest, PushAndDrain) {
+  const auto key = opencensus::tags::TagKey::Register("key");
+  RecordQueue queue(4);
+  Delta delta = MakeDelta();
+
+  opencensus::tags::TagMap tags1({{key, "value1"}});
+  EXPECT_TRUE(
+      queue.Push({{TestMeasure(), 1.0}, {TestMeasure(), 2.0}}, tags1));
+  opencensus::tags::TagMap tags2({{key, "value2"}});
+  EXPECT_TRUE(queue.Push({{TestMeasure(), 3.0}}, tags2));
+
+  EXPECT_EQ(2, queue.DrainInto(&delta));
+  EXPECT_EQ(2, CountFor(delta, opencensus::tags::TagMap({{key, "value1"}})));
+  EXPECT_EQ(1, CountFor(delta, opencensus::tags::TagMap({{key, "value2"}})));
+  EXPECT_EQ(0, queue.DrainInto(&delta));
+}
+
+TEST(RecordQueueTest, FullQueue) {
+  RecordQueue queue(2);
+  Delta delta = MakeDelta();
+  for (int i = 0; i < 2; ++i) {
+    opencensus::tags::TagMap tags({});
+    EXPECT_TRUE(queue.Push({{TestMeasure(), 1.0}}, tags));
+  }
+  opencensus::tags::TagMap tags({});
+  EXPECT_FALSE(queue.Push({{TestMeasure(), 1.0}}, tags));
+
+  // Draining frees up the slots for reuse.
+  EXPECT_EQ(2, queue.DrainInto(&delta));
+  EXPECT_TRUE(queue.Push({{TestMeasure(), 1.0}}, tags));
+  EXPECT_EQ(1, queue.DrainInto(&delta));
+  EXPECT_EQ(3, CountFor(delta, opencensus::tags::TagMap({})));
+}
+
+TEST(RecordQueueTest, TooManyMeasurements) {
+  RecordQueue queue(2);
+  std::vector<Measurement> measurements(RecordQueue::kMaxMeasurements + 1,
+                                        Measurement(TestMeasure(), 1.0));
+  opencensus::tags::TagMap tags({});
+  EXPECT_FALSE(queue.Push(measurements, tags));
+}
+
+TEST(RecordQueueTest, ConcurrentProducers) {
+  const int kNumThreads = 4;
+  const int kNumRecords = 10000;
+  RecordQueue queue(64);
+  Delta delta = MakeDelta();
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&queue]() {
+      for (int j = 0; j < kNumRecords; ++j) {
+        opencensus::tags::TagMap tags({});
+        while (!queue.Push({{TestMeasure(), 1.0}}, tags)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  uint64_t num_drained = 0;
+  while (num_drained < kNumThreads * kNumRecords) {
+    num_drained += queue.DrainInto(&delta);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(kNumThreads * kNumRecords,
+            CountFor(delta, opencensus::tags::TagMap({})));
+}
+
+}  // namespace
+}  // namespace stats
+}  // namespace opencensus
@@ -14,9 +14,13 @@
 
 #include "opencensus/stats/recording.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <initializer_list>
 
+#include "absl/types/span.h"
 #include "opencensus/stats/internal/delta_producer.h"
+#include "opencensus/stats/internal/measure_registry_impl.h"
 #include "opencensus/stats/measure.h"
 #include "opencensus/tags/context_util.h"
 #include "opencensus/tags/tag_map.h"
@@ -31,7 +35,48 @@ void Record(std::initializer_list<Measurement> measurements) {
 
 void Record(std::initializer_list<Measurement> measurements,
             opencensus::tags::TagMap tags) {
-  DeltaProducer::Get()->Record(measurements, std::move(tags));
+  DeltaProducer::Get()->Record(measurements, tags);
+}
+
+namespace {
+
+// Integer values are converted to doubles this many at a time.
+constexpr size_t kConversionBlockSize = 256;
+
+}  // namespace
+
+void RecordBatch(MeasureDouble measure, absl::Span<const double> values) {
+  RecordBatch(measure, values, opencensus::tags::GetCurrentTagMap());
+}
+
+void RecordBatch(MeasureInt64 measure, absl::Span<const int64_t> values) {
+  RecordBatch(measure, values, opencensus::tags::GetCurrentTagMap());
+}
+
+void RecordBatch(MeasureDouble measure, absl::Span<const double> values,
+                 opencensus::tags::TagMap tags) {
+  if (!measure.IsValid()) {
+    return;
+  }
+  DeltaProducer::Get()->RecordBatch(
+      MeasureRegistryImpl::MeasureToIndex(measure), values, tags);
+}
+
+void RecordBatch(MeasureInt64 measure, absl::Span<const int64_t> values,
+                 opencensus::tags::TagMap tags) {
+  if (!measure.IsValid()) {
+    return;
+  }
+  const uint64_t index = MeasureRegistryImpl::MeasureToIndex(measure);
+  double converted[kConversionBlockSize];
+  for (size_t start = 0; start < values.size();
+       start += kConversionBlockSize) {
+    const size_t size = std::min(kConversionBlockSize, values.size() - start);
+    std::copy(values.begin() + start, values.begin() + start + size,
+              converted);
+    DeltaProducer::Get()->RecordBatch(
+        index, absl::Span<const double>(converted, size), tags);
+  }
 }
 
 }  // namespace stats
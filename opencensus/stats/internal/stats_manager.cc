@@ -14,18 +14,27 @@
 
 #include "opencensus/stats/internal/stats_manager.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/base/macros.h"
 #include "absl/memory/memory.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "opencensus/stats/aggregation.h"
 #include "opencensus/stats/bucket_boundaries.h"
+#include "opencensus/stats/internal/aggregation_window.h"
 #include "opencensus/stats/internal/delta_producer.h"
 #include "opencensus/stats/internal/measure_data.h"
 #include "opencensus/stats/internal/measure_registry_impl.h"
+#include "opencensus/stats/internal/worker_pool.h"
 #include "opencensus/stats/view_descriptor.h"
 #include "opencensus/tags/tag_key.h"
 #include "opencensus/tags/tag_map.h"
@@ -35,20 +44,36 @@ namespace stats {
 
 // TODO: See if it is possible to replace AssertHeld() with function
 // annotations.
-// TODO: Optimize selecting/sorting tag values for each view.
+
+namespace {
+
+// The maximum number of entries in a view's row cache, which is cleared when
+// full rather than grow with the number of distinct tagsets merged.
+constexpr size_t kMaxCachedRows = 4096;
+
+}  // namespace
 
 // ========================================================================== //
 // StatsManager::ViewInformation
 
 StatsManager::ViewInformation::ViewInformation(const ViewDescriptor& descriptor,
                                                absl::Mutex* mu)
-    : descriptor_(descriptor), mu_(mu), data_(absl::Now(), descriptor) {}
+    : descriptor_(descriptor), mu_(mu), data_(absl::Now(), descriptor) {
+  const auto& columns = descriptor_.columns();
+  column_plan_.reserve(columns.size());
+  for (int i = 0; i < columns.size(); ++i) {
+    column_plan_.emplace_back(columns[i], i);
+  }
+  std::sort(column_plan_.begin(), column_plan_.end());
+}
 
 bool StatsManager::ViewInformation::Matches(
     const ViewDescriptor& descriptor) const {
   return descriptor.aggregation() == descriptor_.aggregation() &&
          descriptor.aggregation_window_ == descriptor_.aggregation_window_ &&
-         descriptor.columns() == descriptor_.columns();
+         descriptor.columns() == descriptor_.columns() &&
+         descriptor.max_rows() == descriptor_.max_rows() &&
+         descriptor.row_ttl() == descriptor_.row_ttl();
 }
 
 int StatsManager::ViewInformation::num_consumers() const {
@@ -70,38 +95,86 @@ void StatsManager::ViewInformation::MergeMeasureData(
     const opencensus::tags::TagMap& tags, const MeasureData& data,
     absl::Time now) {
   mu_->AssertHeld();
-  std::vector<std::string> tag_values(descriptor_.columns().size());
-  for (int i = 0; i < tag_values.size(); ++i) {
-    const opencensus::tags::TagKey column = descriptor_.columns()[i];
-    for (const auto& tag : tags.tags()) {
-      if (tag.first == column) {
-        tag_values[i] = std::string(tag.second);
-        break;
-      }
+  data_.MergeRow(FindOrAddRow(tags, now), data, now);
+}
+
+ViewDataImpl::Row StatsManager::ViewInformation::FindOrAddRow(
+    const opencensus::tags::TagMap& tags, absl::Time now) {
+  // Snapshots returned by GetData() share data_ until it is next modified.
+  data_.MakeWritable();
+  data_.ExpireRows(now);
+  if (row_cache_generation_ != data_.generation()) {
+    row_cache_.clear();
+    row_cache_generation_ = data_.generation();
+  }
+  const auto it = row_cache_.find(tags);
+  if (it != row_cache_.end()) {
+    return it->second;
+  }
+  std::vector<std::string> tag_values(column_plan_.size());
+  auto tag = tags.tags().begin();
+  for (const auto& column : column_plan_) {
+    while (tag != tags.tags().end() && tag->first < column.first) {
+      ++tag;
+    }
+    if (tag != tags.tags().end() && tag->first == column.first) {
+      tag_values[column.second] = tag->second;
     }
   }
-  data_.Merge(tag_values, data, now);
+  const ViewDataImpl::Row row = data_.FindOrAddRow(tag_values, now);
+  if (row_cache_.size() >= kMaxCachedRows) {
+    row_cache_.clear();
+  }
+  row_cache_.emplace(tags, row);
+  return row;
 }
 
 std::unique_ptr<ViewDataImpl> StatsManager::ViewInformation::GetData() {
+  if (descriptor_.aggregation_window_.type() ==
+      AggregationWindow::Type::kDelta) {
+    // Resetting the data invalidates the row cache, so this cannot share the
+    // lock with other readers.
+    absl::MutexLock l(mu_);
+    return data_.GetDeltaAndReset(absl::Now());
+  }
+  ExpireRows(absl::Now());
   absl::ReaderMutexLock l(mu_);
   if (data_.type() == ViewDataImpl::Type::kStatsObject) {
     return absl::make_unique<ViewDataImpl>(data_, absl::Now());
-  } else if (descriptor_.aggregation_window_.type() ==
-             AggregationWindow::Type::kDelta) {
-    return data_.GetDeltaAndReset(absl::Now());
   } else {
     return absl::make_unique<ViewDataImpl>(data_);
   }
 }
 
+std::unique_ptr<ViewDataImpl> StatsManager::ViewInformation::GetRow(
+    const std::vector<std::string>& tag_values) {
+  ExpireRows(absl::Now());
+  absl::ReaderMutexLock l(mu_);
+  return data_.GetRow(tag_values, absl::Now());
+}
+
+std::unique_ptr<ViewDataImpl> StatsManager::ViewInformation::GetRows(
+    const std::function<bool(const std::vector<std::string>&)>& filter) {
+  ExpireRows(absl::Now());
+  absl::ReaderMutexLock l(mu_);
+  return data_.GetRows(filter, absl::Now());
+}
+
+void StatsManager::ViewInformation::ExpireRows(absl::Time now) {
+  if (descriptor_.row_ttl() == absl::InfiniteDuration()) {
+    return;
+  }
+  absl::MutexLock l(mu_);
+  data_.ExpireRows(now);
+}
+
 // ==========================================================================
 // // StatsManager::MeasureInformation
 
 void StatsManager::MeasureInformation::MergeMeasureData(
     const opencensus::tags::TagMap& tags, const MeasureData& data,
     absl::Time now) {
-  mu_->AssertHeld();
+  mu_.AssertHeld();
   for (auto& view : views_) {
     view->MergeMeasureData(tags, data, now);
   }
@@ -109,20 +182,25 @@ void StatsManager::MeasureInformation::MergeMeasureData(
 
 StatsManager::ViewInformation* StatsManager::MeasureInformation::AddConsumer(
     const ViewDescriptor& descriptor) {
-  mu_->AssertHeld();
+  mu_.AssertHeld();
   for (auto& view : views_) {
     if (view->Matches(descriptor)) {
       view->AddConsumer();
       return view.get();
     }
   }
-  views_.emplace_back(new ViewInformation(descriptor, mu_));
+  views_.emplace_back(new ViewInformation(descriptor, &mu_));
   return views_.back().get();
 }
 
+bool StatsManager::MeasureInformation::has_views() const {
+  mu_.AssertReaderHeld();
+  return !views_.empty();
+}
+
 void StatsManager::MeasureInformation::RemoveView(
     const ViewInformation* handle) {
-  mu_->AssertHeld();
+  mu_.AssertHeld();
   for (auto it = views_.begin(); it != views_.end(); ++it) {
     if (it->get() == handle) {
       ABSL_ASSERT((*it)->num_consumers() == 0);
@@ -144,27 +222,80 @@ StatsManager* StatsManager::Get() {
   return global_stats_manager;
 }
 
-void StatsManager::MergeDelta(const Delta& delta) {
-  absl::MutexLock l(&mu_);
-  absl::Time now = absl::Now();
+void StatsManager::MergeDeltas(absl::Span<const Delta> deltas) {
+  absl::ReaderMutexLock l(&mu_);
   // Measures are added to the StatsManager before the DeltaProducer, so there
-  // should never be measures in the delta missing from measures_.
-  for (const auto& data_for_tagset : delta.delta()) {
-    for (int i = 0; i < data_for_tagset.second.size(); ++i) {
-      // Only add data if there is data for this tagset/measure combination, to
-      // avoid creating spurious empty rows.
-      if (data_for_tagset.second[i].count() != 0) {
-        measures_[i].MergeMeasureData(data_for_tagset.first,
-                                      data_for_tagset.second[i], now);
+  // should never be measures in the delta missing from measures_. Groups the
+  // entries by measure in one pass over the deltas.
+  std::vector<std::vector<
+      std::pair<const opencensus::tags::TagMap*, const MeasureData*>>>
+      entries_by_measure(measures_.size());
+  for (const auto& delta : deltas) {
+    const DeltaTable& table = delta.delta();
+    for (size_t row = 0; row < table.size(); ++row) {
+      for (const auto& entry : table.row(row)) {
+        // Only add data if there is data for this tagset/measure combination,
+        // to avoid creating spurious empty rows. Rows may hold empty entries
+        // left over from their reuse.
+        if (entry.data.count() != 0) {
+          entries_by_measure[entry.measure_index].emplace_back(
+              &table.tags(row), &entry.data);
+        }
       }
     }
   }
+  std::vector<std::pair<uint64_t, MeasureInformation*>> measures_to_merge;
+  for (size_t index = 0; index < entries_by_measure.size(); ++index) {
+    if (!entries_by_measure[index].empty()) {
+      measures_to_merge.emplace_back(index, measures_[index].get());
+    }
+  }
+  if (measures_to_merge.empty()) {
+    return;
+  }
+
+  const absl::Time now = absl::Now();
+  // Merges one measure at a time, so that each measure's mutex is acquired
+  // once per merge rather than once per row, and measures can be merged in
+  // parallel without contending.
+  const std::function<void(int)> merge_measure = [&](int i) {
+    const uint64_t index = measures_to_merge[i].first;
+    MeasureInformation& measure = *measures_to_merge[i].second;
+    absl::MutexLock measure_lock(measure.mu());
+    for (const auto& entry : entries_by_measure[index]) {
+      measure.MergeMeasureData(*entry.first, *entry.second, now);
+    }
+  };
+  absl::MutexLock pool_lock(&merge_pool_mu_);
+  if (merge_pool_ == nullptr || measures_to_merge.size() == 1) {
+    for (int i = 0; i < measures_to_merge.size(); ++i) {
+      merge_measure(i);
+    }
+  } else {
+    merge_pool_->ParallelFor(measures_to_merge.size(), merge_measure);
+  }
+}
+
+void StatsManager::SetMergeThreads(int num_threads) {
+  if (num_threads < 1) {
+    std::cerr << "StatsManager::SetMergeThreads() called with non-positive "
+                 "number of threads: "
+              << num_threads << "\n";
+    return;
+  }
+  absl::MutexLock l(&merge_pool_mu_);
+  if (num_threads == 1) {
+    merge_pool_.reset();
+  } else if (merge_pool_ == nullptr ||
+             merge_pool_->num_threads() != num_threads - 1) {
+    merge_pool_ = absl::make_unique<WorkerPool>(num_threads - 1);
+  }
 }
 
 template <typename MeasureT>
 void StatsManager::AddMeasure(Measure<MeasureT> measure) {
   absl::MutexLock l(&mu_);
-  measures_.emplace_back(MeasureInformation(&mu_));
+  measures_.emplace_back(new MeasureInformation);
   ABSL_ASSERT(measures_.size() ==
               MeasureRegistryImpl::MeasureToIndex(measure) + 1);
 }
@@ -188,20 +319,45 @@ StatsManager::ViewInformation* StatsManager::AddConsumer(
     DeltaProducer::Get()->AddBoundaries(
         index, descriptor.aggregation().bucket_boundaries());
   }
-  absl::MutexLock l(&mu_);
-  return measures_[index].AddConsumer(descriptor);
+  DeltaProducer::Get()->AddViewColumns(index, descriptor.columns());
+  DeltaProducer::Get()->AddViewAggregation(index,
+                                           descriptor.aggregation().type());
+  absl::ReaderMutexLock l(&mu_);
+  MeasureInformation& measure = *measures_[index];
+  absl::MutexLock measure_lock(measure.mu());
+  if (!measure.has_views()) {
+    // Updated under the measure's mutex so that concurrent view additions and
+    // removals for the measure are applied in order.
+    DeltaProducer::Get()->SetMeasureHasConsumers(index, true);
+  }
+  return measure.AddConsumer(descriptor);
 }
 
 void StatsManager::RemoveConsumer(ViewInformation* handle) {
-  absl::MutexLock l(&mu_);
-  const int num_consumers_remaining = handle->RemoveConsumer();
-  ABSL_ASSERT(num_consumers_remaining >= 0);
-  if (num_consumers_remaining == 0) {
+  uint64_t index;
+  std::vector<opencensus::tags::TagKey> columns;
+  Aggregation::Type aggregation_type;
+  {
+    absl::ReaderMutexLock l(&mu_);
     const auto& descriptor = handle->view_descriptor();
-    const uint64_t index =
-        MeasureRegistryImpl::IdToIndex(descriptor.measure_id_);
-    measures_[index].RemoveView(handle);
+    index = MeasureRegistryImpl::IdToIndex(descriptor.measure_id_);
+    columns = descriptor.columns();
+    aggregation_type = descriptor.aggregation().type();
+    MeasureInformation& measure = *measures_[index];
+    absl::MutexLock measure_lock(measure.mu());
+    const int num_consumers_remaining = handle->RemoveConsumer();
+    ABSL_ASSERT(num_consumers_remaining >= 0);
+    if (num_consumers_remaining == 0) {
+      measure.RemoveView(handle);
+      if (!measure.has_views()) {
+        DeltaProducer::Get()->SetMeasureHasConsumers(index, false);
+      }
+    }
   }
+  // Like AddBoundaries() in AddConsumer(), this acquires DeltaProducer locks
+  // that must not be taken while holding StatsManager locks.
+  DeltaProducer::Get()->RemoveViewColumns(index, columns);
+  DeltaProducer::Get()->RemoveViewAggregation(index, aggregation_type);
 }
 
 }  // namespace stats
@@ -15,7 +15,13 @@
 #ifndef OPENCENSUS_STATS_INTERNAL_STATS_MANAGER_H_
 #define OPENCENSUS_STATS_INTERNAL_STATS_MANAGER_H_
 
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
@@ -25,6 +31,7 @@
 #include "opencensus/stats/internal/delta_producer.h"
 #include "opencensus/stats/internal/measure_data.h"
 #include "opencensus/stats/internal/view_data_impl.h"
+#include "opencensus/stats/internal/worker_pool.h"
 #include "opencensus/stats/measure.h"
 #include "opencensus/stats/view_descriptor.h"
 #include "opencensus/tags/tag_key.h"
@@ -63,6 +70,14 @@ class StatsManager final {
 
     // Retrieves a copy of the data.
     std::unique_ptr<ViewDataImpl> GetData() LOCKS_EXCLUDED(*mu_);
+    // Retrieves a copy of the row 'tag_values', if present. Unlike GetData(),
+    // this does not reset Delta-window data.
+    std::unique_ptr<ViewDataImpl> GetRow(
+        const std::vector<std::string>& tag_values) LOCKS_EXCLUDED(*mu_);
+    // Retrieves a copy of the rows whose tag values satisfy 'filter'.
+    std::unique_ptr<ViewDataImpl> GetRows(
+        const std::function<bool(const std::vector<std::string>&)>& filter)
+        LOCKS_EXCLUDED(*mu_);
 
     const ViewDescriptor& view_descriptor() const { return descriptor_; }
 
@@ -78,14 +93,44 @@ class StatsManager final {
     enum class DataType { kDouble, kUint64, kDistribution, kInterval };
     static DataType DataTypeForDescriptor(const ViewDescriptor& descriptor);
 
+    // Returns the row of data_ for 'tags', adding it at 'now' if needed.
+    // Requires holding *mu_.
+    ViewDataImpl::Row FindOrAddRow(const opencensus::tags::TagMap& tags,
+                                   absl::Time now);
+    // Drops rows that expired before 'now', so that snapshots exclude them.
+    void ExpireRows(absl::Time now) LOCKS_EXCLUDED(*mu_);
+
+    // The index of each column in the descriptor, sorted by key like the tags
+    // of a TagMap, so that tag values are selected in a single pass.
+    std::vector<std::pair<opencensus::tags::TagKey, int>> column_plan_;
+
     ViewDataImpl data_ GUARDED_BY(*mu_);
+
+    // The row of data_ for recently merged tags, so that merging under the
+    // same tags again skips building and hashing their tag values. Valid while
+    // data_.generation() equals row_cache_generation_.
+    std::unordered_map<opencensus::tags::TagMap, ViewDataImpl::Row,
+                       opencensus::tags::TagMap::Hash>
+        row_cache_ GUARDED_BY(*mu_);
+    uint64_t row_cache_generation_ GUARDED_BY(*mu_) = 0;
   };
 
  public:
   static StatsManager* Get();
 
   // Merges all data from 'delta' at the present time.
-  void MergeDelta(const Delta& delta) LOCKS_EXCLUDED(mu_);
+  void MergeDelta(const Delta& delta) LOCKS_EXCLUDED(mu_, merge_pool_mu_) {
+    MergeDeltas(absl::Span<const Delta>(&delta, 1));
+  }
+  // Merges all data from 'deltas' at the present time. The work is partitioned
+  // by measure across the merge threads.
+  void MergeDeltas(absl::Span<const Delta> deltas)
+      LOCKS_EXCLUDED(mu_, merge_pool_mu_);
+
+  // Sets the number of threads that merge deltas, counting the thread calling
+  // MergeDeltas() (usually the harvester). The default of 1 merges on the
+  // calling thread only.
+  void SetMergeThreads(int num_threads) LOCKS_EXCLUDED(merge_pool_mu_);
 
   // Adds a measure--this is necessary for views to be added under that measure.
   template <typename MeasureT>
@@ -101,33 +146,47 @@ class StatsManager final {
   void RemoveConsumer(ViewInformation* handle) LOCKS_EXCLUDED(mu_);
 
  private:
-  // MeasureInformation stores all ViewInformation objects for a given measure.
+  // MeasureInformation stores all ViewInformation objects for a given measure,
+  // along with the mutex guarding them.
   class MeasureInformation {
    public:
-    explicit MeasureInformation(absl::Mutex* mu) : mu_(mu) {}
-
     // Merges measure_data into all views under this measure. Requires holding
-    // *mu_;
+    // mu_.
     void MergeMeasureData(const opencensus::tags::TagMap& tags,
                           const MeasureData& data, absl::Time now);
 
+    // Require holding mu_.
     ViewInformation* AddConsumer(const ViewDescriptor& descriptor);
     void RemoveView(const ViewInformation* handle);
 
+    // Whether any view uses this measure. Requires holding mu_.
+    bool has_views() const;
+
+    absl::Mutex* mu() LOCK_RETURNED(mu_) { return &mu_; }
+
    private:
-    absl::Mutex* const mu_;  // Not owned.
+    // Guards views_ and the data of each view, so that merging into or reading
+    // one measure's views does not block other measures.
+    mutable absl::Mutex mu_;
     // View objects hold a pointer to ViewInformation directly, so we do not
     // need fast lookup--lookup is only needed for view removal.
-    std::vector<std::unique_ptr<ViewInformation>> views_ GUARDED_BY(*mu_);
+    std::vector<std::unique_ptr<ViewInformation>> views_ GUARDED_BY(mu_);
   };
 
-  // TODO: PERF: Global synchronization is only needed for adding or
-  // removing measures--we can reduce recording contention by claiming a reader
-  // lock on mu_ and a writer lock on a measure-specific mutex.
+  // Guards measures_ itself. Adding a measure takes mu_ exclusively; everything
+  // else takes a reader lock on mu_ and then the mutex of the measures it
+  // touches. ViewInformation::GetData() takes only its measure's mutex, since
+  // measures are never removed.
   mutable absl::Mutex mu_;
 
-  // All registered measures.
-  std::vector<MeasureInformation> measures_ GUARDED_BY(mu_);
+  // All registered measures, by index. MeasureInformation is not movable, so
+  // each is allocated separately.
+  std::vector<std::unique_ptr<MeasureInformation>> measures_ GUARDED_BY(mu_);
+
+  absl::Mutex merge_pool_mu_ ACQUIRED_AFTER(mu_);
+  // The threads merging alongside the calling thread, or null if there are
+  // none.
+  std::unique_ptr<WorkerPool> merge_pool_ GUARDED_BY(merge_pool_mu_);
 };
 
 extern template void StatsManager::AddMeasure(MeasureDouble measure);
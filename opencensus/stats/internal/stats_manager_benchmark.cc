@@ -12,7 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <atomic>
 #include <memory>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
@@ -20,11 +22,15 @@
 #include "benchmark/benchmark.h"
 #include "opencensus/stats/aggregation.h"
 #include "opencensus/stats/internal/aggregation_window.h"
+#include "opencensus/stats/internal/delta_producer.h"
+#include "opencensus/stats/internal/measure_registry_impl.h"
 #include "opencensus/stats/internal/set_aggregation_window.h"
+#include "opencensus/stats/internal/stats_manager.h"
 #include "opencensus/stats/measure.h"
 #include "opencensus/stats/recording.h"
 #include "opencensus/stats/view.h"
 #include "opencensus/stats/view_descriptor.h"
+#include "opencensus/tags/with_tag_map.h"
 
 namespace opencensus {
 namespace stats {
@@ -118,6 +124,80 @@ BENCHMARK_TEMPLATE2(BM_Record, DistributionAggregation, CumulativeWindow)
 BENCHMARK_TEMPLATE2(BM_Record, DistributionAggregation, IntervalWindow)
     ->Range(1, 16);
 
+// Benchmarks recording through a BoundMeasure against a single view, for
+// comparison with BM_Record.
+template <class AggregationFactory>
+void BM_RecordBound(benchmark::State& state) {
+  const opencensus::tags::TagKey tag_key_1 =
+      opencensus::tags::TagKey::Register("tag_key_1");
+  const opencensus::tags::TagKey tag_key_2 =
+      opencensus::tags::TagKey::Register("tag_key_2");
+  const std::string measure_name = MakeUniqueName();
+  MeasureDouble measure = MeasureDouble::Register(measure_name, "", "");
+  View view(ViewDescriptor()
+                .set_measure(measure_name)
+                .set_name("view")
+                .set_aggregation(AggregationFactory()(
+                    BucketBoundaries::Exponential(10, 10, 2)))
+                .add_column(tag_key_1));
+  const BoundMeasureDouble bound =
+      measure.Bind({{tag_key_1, "value"}, {tag_key_2, ""}});
+  int iteration = 0;
+  for (auto _ : state) {
+    bound.Record(static_cast<double>(iteration));
+    ++iteration;
+  }
+}
+BENCHMARK_TEMPLATE(BM_RecordBound, SumAggregation);
+BENCHMARK_TEMPLATE(BM_RecordBound, CountAggregation);
+BENCHMARK_TEMPLATE(BM_RecordBound, DistributionAggregation);
+
+// Benchmarks many threads recording through the same BoundMeasure, which
+// records into the calling thread's shard of the bound cell.
+void BM_RecordBoundContended(benchmark::State& state) {
+  static const BoundMeasureDouble* const bound = [] {
+    const opencensus::tags::TagKey tag_key =
+        opencensus::tags::TagKey::Register("tag_key_1");
+    const std::string measure_name = MakeUniqueName();
+    MeasureDouble measure = MeasureDouble::Register(measure_name, "", "");
+    // Leaked, like the bound measure, to outlive all benchmark threads.
+    new View(ViewDescriptor()
+                 .set_measure(measure_name)
+                 .set_name("view")
+                 .set_aggregation(Aggregation::Sum())
+                 .add_column(tag_key));
+    return new BoundMeasureDouble(measure.Bind({{tag_key, "value"}}));
+  }();
+  for (auto _ : state) {
+    bound->Record(1.0);
+  }
+}
+BENCHMARK(BM_RecordBoundContended)->ThreadRange(1, 16);
+
+// Benchmarks recording under the tags of the current context against a single
+// view.
+void BM_RecordCurrentTags(benchmark::State& state) {
+  const opencensus::tags::TagKey tag_key_1 =
+      opencensus::tags::TagKey::Register("tag_key_1");
+  const opencensus::tags::TagKey tag_key_2 =
+      opencensus::tags::TagKey::Register("tag_key_2");
+  const std::string measure_name = MakeUniqueName();
+  MeasureDouble measure = MeasureDouble::Register(measure_name, "", "");
+  View view(ViewDescriptor()
+                .set_measure(measure_name)
+                .set_name("view")
+                .set_aggregation(Aggregation::Sum())
+                .add_column(tag_key_1));
+  opencensus::tags::WithTagMap with_tags({{tag_key_1, "value"},
+                                          {tag_key_2, ""}});
+  int iteration = 0;
+  for (auto _ : state) {
+    Record({{measure, static_cast<double>(iteration)}});
+    ++iteration;
+  }
+}
+BENCHMARK(BM_RecordCurrentTags);
+
 // Benchmarks batched recording against a set of measures with a small number of
 // views on each, matching RPC stats recording.
 void BM_RecordBatched(benchmark::State& state) {
@@ -180,8 +260,92 @@ void BM_RecordBatched(benchmark::State& state) {
 }
 BENCHMARK(BM_RecordBatched);
 
+// Benchmarks recording from multiple threads against a single measure with a
+// sum view, with each thread recording under its own tags.
+void BM_RecordMultithreaded(benchmark::State& state) {
+  static const opencensus::tags::TagKey tag_key =
+      opencensus::tags::TagKey::Register("tag_key_1");
+  static const std::string measure_name = MakeUniqueName();
+  static const MeasureDouble measure =
+      MeasureDouble::Register(measure_name, "", "");
+  static const View* view = new View(ViewDescriptor()
+                                         .set_measure(measure_name)
+                                         .set_name("sum")
+                                         .set_aggregation(Aggregation::Sum())
+                                         .add_column(tag_key));
+  benchmark::DoNotOptimize(view);
+  static std::atomic<int> thread_counter(0);
+  const std::string tag_value = absl::StrCat("value", thread_counter++);
+  const opencensus::tags::TagMap tags({{tag_key, tag_value}});
+  int iteration = 0;
+  for (auto _ : state) {
+    Record({{measure, static_cast<double>(iteration)}}, tags);
+    ++iteration;
+  }
+}
+BENCHMARK(BM_RecordMultithreaded)->ThreadRange(1, 64)->UseRealTime();
+
+// Benchmarks merging a delta with state.range(0) tagsets into a count and a sum
+// view, as the harvester does on every flush.
+void BM_MergeDelta(benchmark::State& state) {
+  const opencensus::tags::TagKey tag_key_1 =
+      opencensus::tags::TagKey::Register("tag_key_1");
+  const opencensus::tags::TagKey tag_key_2 =
+      opencensus::tags::TagKey::Register("tag_key_2");
+  const std::string measure_name = MakeUniqueName();
+  MeasureDouble measure = MeasureDouble::Register(measure_name, "", "");
+  View count_view(ViewDescriptor()
+                      .set_measure(measure_name)
+                      .set_name("count")
+                      .set_aggregation(Aggregation::Count())
+                      .add_column(tag_key_1)
+                      .add_column(tag_key_2));
+  View sum_view(ViewDescriptor()
+                    .set_measure(measure_name)
+                    .set_name("sum")
+                    .set_aggregation(Aggregation::Sum())
+                    .add_column(tag_key_1)
+                    .add_column(tag_key_2));
+
+  std::vector<std::vector<BucketBoundaries>> boundaries(
+      MeasureRegistryImpl::MeasureToIndex(measure) + 1);
+  Delta delta;
+  Delta unused;
+  delta.SwapAndReset(boundaries, &unused);
+  for (int i = 0; i < state.range(0); ++i) {
+    delta.Record({{measure, 1.0}}, {{tag_key_1, absl::StrCat("value", i)},
+                                    {tag_key_2, "value"}});
+  }
+  for (auto _ : state) {
+    StatsManager::Get()->MergeDelta(delta);
+  }
+}
+BENCHMARK(BM_MergeDelta)->Range(1, 1024);
+
+// Benchmarks taking a snapshot of a sum view with state.range(0) rows, as
+// exporters do on every export.
+void BM_GetData(benchmark::State& state) {
+  const opencensus::tags::TagKey tag_key_1 =
+      opencensus::tags::TagKey::Register("tag_key_1");
+  const std::string measure_name = MakeUniqueName();
+  MeasureDouble measure = MeasureDouble::Register(measure_name, "", "");
+  View view(ViewDescriptor()
+                .set_measure(measure_name)
+                .set_name("sum")
+                .set_aggregation(Aggregation::Sum())
+                .add_column(tag_key_1));
+  for (int i = 0; i < state.range(0); ++i) {
+    Record({{measure, 1.0}}, {{tag_key_1, absl::StrCat("value", i)}});
+  }
+  DeltaProducer::Get()->Flush();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(view.GetData());
+  }
+}
+BENCHMARK(BM_GetData)->Range(1, 1 << 14);
+
 // TODO: Other useful benchmarks:
-//  - Multithreaded recording against one/different measures.
+//  - Multithreaded recording against different measures.
 //  - Recording with parameterized numbers of tag keys.
 
 }  // namespace
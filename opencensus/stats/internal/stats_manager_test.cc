@@ -12,9 +12,17 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "opencensus/stats/internal/delta_producer.h"
+#include "opencensus/stats/internal/stats_manager.h"
 #include "opencensus/stats/measure.h"
 #include "opencensus/stats/recording.h"
 #include "opencensus/stats/testing/test_utils.h"
@@ -262,6 +270,38 @@ TEST_F(StatsManagerTest, Distribution) {
               ::testing::ElementsAre(1, 0));
 }
 
+TEST_F(StatsManagerTest, RecordBatch) {
+  ViewDescriptor view_descriptor =
+      ViewDescriptor()
+          .set_measure(kSecondMeasureId)
+          .set_name("record_batch")
+          .set_aggregation(
+              Aggregation::Distribution(BucketBoundaries::Explicit({10})))
+          .add_column(key1_);
+  View view(view_descriptor);
+
+  // Longer than a conversion block of integer values.
+  std::vector<int64_t> values(1000, 5);
+  values[500] = 15;
+  RecordBatch(SecondMeasure(), values);
+  RecordBatch(SecondMeasure(), {20, 30}, {{key1_, "value1"}});
+  RecordBatch(SecondMeasure(), {}, {{key1_, "value2"}});
+  // Stats under a different measure should be ignored.
+  RecordBatch(FirstMeasure(), {1.0, 2.0});
+  testing::TestUtils::Flush();
+  const opencensus::stats::ViewData data = view.GetData();
+  EXPECT_EQ(2, data.distribution_data().size());
+  const Distribution& distribution =
+      data.distribution_data().find({""})->second;
+  EXPECT_EQ(1000, distribution.count());
+  EXPECT_DOUBLE_EQ(5.01, distribution.mean());
+  EXPECT_EQ(15, distribution.max());
+  EXPECT_THAT(distribution.bucket_counts(), ::testing::ElementsAre(999, 1));
+  EXPECT_THAT(
+      data.distribution_data().find({"value1"})->second.bucket_counts(),
+      ::testing::ElementsAre(0, 2));
+}
+
 TEST_F(StatsManagerTest, Delta) {
   ViewDescriptor view_descriptor = ViewDescriptor()
                                        .set_measure(kFirstMeasureId)
@@ -294,6 +334,13 @@ TEST_F(StatsManagerTest, Delta) {
   EXPECT_THAT(view.GetData().int_data(),
               ::testing::UnorderedElementsAre(
                   ::testing::Pair(::testing::ElementsAre("new_value", ""), 1)));
+
+  // The same tags are merged into a new row after the reset.
+  Record({{FirstMeasure(), 4.0}}, {{key1_, "new_value"}});
+  testing::TestUtils::Flush();
+  EXPECT_THAT(view.GetData().int_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre("new_value", ""), 1)));
 }
 
 // TODO: Test window expiration if we add a simulated clock.
@@ -390,6 +437,52 @@ TEST_F(StatsManagerTest, IntervalDistribution) {
                                                ->second.bucket_counts());
 }
 
+TEST_F(StatsManagerTest, IntervalLogLinearHistogram) {
+  ViewDescriptor view_descriptor =
+      ViewDescriptor()
+          .set_measure(kFirstMeasureId)
+          .set_name("log-linear-interval")
+          .set_aggregation(Aggregation::LogLinearHistogram(3));
+  SetAggregationWindow(AggregationWindow::Interval(absl::Hours(1)),
+                       &view_descriptor);
+  View view(view_descriptor);
+  ASSERT_TRUE(view.IsValid());
+
+  Record({{FirstMeasure(), 1000.0}, {FirstMeasure(), 0.001}});
+  testing::TestUtils::Flush();
+  const ViewData data = view.GetData();
+  ASSERT_EQ(1, data.distribution_data().size());
+  const Distribution& distribution = data.distribution_data().begin()->second;
+  const BucketBoundaries& buckets = distribution.bucket_boundaries();
+  EXPECT_EQ(2, distribution.count());
+  EXPECT_EQ(buckets.BucketForValue(0.001), distribution.bucket_offset());
+  EXPECT_EQ(buckets.BucketForValue(1000) - buckets.BucketForValue(0.001) + 1,
+            distribution.bucket_counts().size());
+}
+
+TEST_F(StatsManagerTest, IntervalQuantileSketch) {
+  ViewDescriptor view_descriptor =
+      ViewDescriptor()
+          .set_measure(kFirstMeasureId)
+          .set_name("sketch-interval")
+          .set_aggregation(Aggregation::QuantileSketch(3, 16));
+  SetAggregationWindow(AggregationWindow::Interval(absl::Hours(1)),
+                       &view_descriptor);
+  View view(view_descriptor);
+  ASSERT_TRUE(view.IsValid());
+
+  for (int i = 1; i <= 1000; ++i) {
+    Record({{FirstMeasure(), static_cast<double>(i)}});
+  }
+  testing::TestUtils::Flush();
+  const ViewData data = view.GetData();
+  ASSERT_EQ(1, data.distribution_data().size());
+  const Distribution& distribution = data.distribution_data().begin()->second;
+  EXPECT_EQ(1000, distribution.count());
+  EXPECT_EQ(16, distribution.bucket_counts().size());
+  EXPECT_NEAR(990, distribution.Quantile(0.99), 990 / 16.0);
+}
+
 TEST_F(StatsManagerTest, IdenticalViews) {
   ViewDescriptor view_descriptor = ViewDescriptor()
                                        .set_measure(kFirstMeasureId)
@@ -434,6 +527,489 @@ TEST_F(StatsManagerTest, IdenticalViews) {
   EXPECT_TRUE(view.GetData().int_data().empty());
 }
 
+TEST_F(StatsManagerTest, BoundMeasure) {
+  const BucketBoundaries buckets = BucketBoundaries::Explicit({0, 10});
+  ViewDescriptor view_descriptor =
+      ViewDescriptor()
+          .set_measure(kSecondMeasureId)
+          .set_name("distribution")
+          .set_aggregation(Aggregation::Distribution(buckets))
+          .add_column(key1_);
+  View view(view_descriptor);
+
+  const BoundMeasureInt64 bound = SecondMeasure().Bind({{key1_, "value1"}});
+  {
+    const BoundMeasureInt64 copy = bound;
+    copy.Record(5);
+  }
+  bound.Record(15);
+  // Data recorded through bound measures merges with data recorded through
+  // Record().
+  Record({{SecondMeasure(), 1}}, {{key1_, "value1"}, {key2_, "value2"}});
+  testing::TestUtils::Flush();
+  bound.Record(-5);
+  testing::TestUtils::Flush();
+
+  const ViewData data = view.GetData();
+  ASSERT_EQ(1, data.distribution_data().size());
+  const Distribution& distribution = data.distribution_data().begin()->second;
+  EXPECT_THAT(data.distribution_data().begin()->first,
+              ::testing::ElementsAre("value1"));
+  EXPECT_EQ(4, distribution.count());
+  EXPECT_DOUBLE_EQ(4, distribution.mean());
+  EXPECT_DOUBLE_EQ(-5, distribution.min());
+  EXPECT_DOUBLE_EQ(15, distribution.max());
+  EXPECT_THAT(distribution.bucket_counts(), ::testing::ElementsAre(1, 2, 1));
+}
+
+TEST_F(StatsManagerTest, MultithreadedRecording) {
+  ViewDescriptor view_descriptor = ViewDescriptor()
+                                       .set_measure(kFirstMeasureId)
+                                       .set_name("sum_double")
+                                       .set_aggregation(Aggregation::Sum())
+                                       .add_column(key1_);
+  View view(view_descriptor);
+
+  // Threads may record into different shards of the delta; all of them should
+  // be merged on flush.
+  const int kNumThreads = 8;
+  const int kNumRecords = 1000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([this, i]() {
+      for (int j = 0; j < kNumRecords; ++j) {
+        Record({{FirstMeasure(), 1.0}}, {{key1_, i % 2 ? "odd" : "even"}});
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  testing::TestUtils::Flush();
+  EXPECT_THAT(view.GetData().double_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre("even"),
+                                  kNumThreads / 2 * kNumRecords),
+                  ::testing::Pair(::testing::ElementsAre("odd"),
+                                  kNumThreads / 2 * kNumRecords)));
+}
+
+TEST_F(StatsManagerTest, MultithreadedBoundMeasure) {
+  ViewDescriptor view_descriptor =
+      ViewDescriptor()
+          .set_measure(kFirstMeasureId)
+          .set_name("distribution_double")
+          .set_aggregation(
+              Aggregation::Distribution(BucketBoundaries::Explicit({5})))
+          .add_column(key1_);
+  View view(view_descriptor);
+
+  // Threads sharing a BoundMeasure record into different shards of its cell,
+  // while harvests merge them; no record may be lost.
+  const BoundMeasureDouble bound = FirstMeasure().Bind({{key1_, "value1"}});
+  const int kNumThreads = 8;
+  const int kNumRecords = 1000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&bound, i]() {
+      for (int j = 0; j < kNumRecords; ++j) {
+        bound.Record(i);
+      }
+    });
+  }
+  for (int i = 0; i < 10; ++i) {
+    testing::TestUtils::Flush();
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  testing::TestUtils::Flush();
+  const ViewData data = view.GetData();
+  ASSERT_EQ(1, data.distribution_data().size());
+  const Distribution& distribution = data.distribution_data().begin()->second;
+  EXPECT_EQ(kNumThreads * kNumRecords, distribution.count());
+  EXPECT_NEAR((kNumThreads - 1) / 2.0, distribution.mean(), 1e-9);
+  EXPECT_EQ(0, distribution.min());
+  EXPECT_EQ(kNumThreads - 1, distribution.max());
+  EXPECT_THAT(distribution.bucket_counts(),
+              ::testing::ElementsAre(5 * kNumRecords,
+                                     (kNumThreads - 5) * kNumRecords));
+}
+
+TEST_F(StatsManagerTest, QueuedRecording) {
+  ViewDescriptor view_descriptor = ViewDescriptor()
+                                       .set_measure(kFirstMeasureId)
+                                       .set_name("sum_double")
+                                       .set_aggregation(Aggregation::Sum())
+                                       .add_column(key1_);
+  View view(view_descriptor);
+
+  DeltaProducer::Get()->SetRecordMode(DeltaProducer::RecordMode::kQueued);
+  Record({{FirstMeasure(), 1.0}, {FirstMeasure(), 2.0}}, {{key1_, "value1"}});
+  Record({{FirstMeasure(), 4.0}}, {{key1_, "value2"}});
+  testing::TestUtils::Flush();
+  DeltaProducer::Get()->SetRecordMode(DeltaProducer::RecordMode::kLocked);
+
+  EXPECT_THAT(view.GetData().double_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre("value1"), 3.0),
+                  ::testing::Pair(::testing::ElementsAre("value2"), 4.0)));
+  EXPECT_EQ(0, DeltaProducer::Get()->dropped_records());
+}
+
+TEST_F(StatsManagerTest, QueuedRecordingBeforeAddingView) {
+  View sum_view(ViewDescriptor()
+                    .set_measure(kFirstMeasureId)
+                    .set_name("sum_double")
+                    .set_aggregation(Aggregation::Sum())
+                    .add_column(key1_));
+
+  // Records queued before a view is added belong to the earlier views only,
+  // whether the new view adds columns or statistics.
+  DeltaProducer::Get()->SetRecordMode(DeltaProducer::RecordMode::kQueued);
+  Record({{FirstMeasure(), 1.0}}, {{key1_, "value1"}, {key2_, "value2"}});
+  View columns_view(ViewDescriptor()
+                        .set_measure(kFirstMeasureId)
+                        .set_name("sum_double_2")
+                        .set_aggregation(Aggregation::Sum())
+                        .add_column(key1_)
+                        .add_column(key2_));
+  Record({{FirstMeasure(), 2.0}}, {{key1_, "value1"}, {key2_, "value2"}});
+  View distribution_view(
+      ViewDescriptor()
+          .set_measure(kFirstMeasureId)
+          .set_name("distribution_double")
+          .set_aggregation(
+              Aggregation::Distribution(BucketBoundaries::Explicit({})))
+          .add_column(key1_));
+  testing::TestUtils::Flush();
+  DeltaProducer::Get()->SetRecordMode(DeltaProducer::RecordMode::kLocked);
+
+  EXPECT_THAT(sum_view.GetData().double_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(
+                  ::testing::ElementsAre("value1"), 3.0)));
+  EXPECT_THAT(columns_view.GetData().double_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(
+                  ::testing::ElementsAre("value1", "value2"), 2.0)));
+  EXPECT_TRUE(distribution_view.GetData().distribution_data().empty());
+}
+
+TEST_F(StatsManagerTest, ConcurrentReadsAndMerges) {
+  View view1(ViewDescriptor()
+                 .set_measure(kFirstMeasureId)
+                 .set_name("sum1")
+                 .set_aggregation(Aggregation::Sum())
+                 .add_column(key1_));
+  View view2(ViewDescriptor()
+                 .set_measure(kSecondMeasureId)
+                 .set_name("sum2")
+                 .set_aggregation(Aggregation::Sum())
+                 .add_column(key1_));
+  // Views of one measure are read while the other measure is merged.
+  const int kNumIterations = 100;
+  std::thread reader([&view1]() {
+    for (int i = 0; i < kNumIterations; ++i) {
+      view1.GetData();
+    }
+  });
+  for (int i = 0; i < kNumIterations; ++i) {
+    Record({{FirstMeasure(), 1.0}, {SecondMeasure(), 2}}, {{key1_, "value"}});
+    testing::TestUtils::Flush();
+  }
+  reader.join();
+  EXPECT_THAT(view1.GetData().double_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(
+                  ::testing::ElementsAre("value"), kNumIterations)));
+  EXPECT_THAT(view2.GetData().int_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(
+                  ::testing::ElementsAre("value"), 2 * kNumIterations)));
+}
+
+TEST_F(StatsManagerTest, ParallelMerge) {
+  View view1(ViewDescriptor()
+                 .set_measure(kFirstMeasureId)
+                 .set_name("sum1")
+                 .set_aggregation(Aggregation::Sum())
+                 .add_column(key1_));
+  View view2(ViewDescriptor()
+                 .set_measure(kSecondMeasureId)
+                 .set_name("count2")
+                 .set_aggregation(Aggregation::Count())
+                 .add_column(key2_));
+  StatsManager::Get()->SetMergeThreads(3);
+  for (int i = 0; i < 10; ++i) {
+    Record({{FirstMeasure(), 1.0}, {SecondMeasure(), 1}},
+           {{key1_, absl::StrCat("value", i % 2)}, {key2_, "value"}});
+  }
+  testing::TestUtils::Flush();
+  StatsManager::Get()->SetMergeThreads(1);
+  EXPECT_THAT(view1.GetData().double_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre("value0"), 5),
+                  ::testing::Pair(::testing::ElementsAre("value1"), 5)));
+  EXPECT_THAT(view2.GetData().int_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre("value"), 10)));
+}
+
+TEST_F(StatsManagerTest, SnapshotUnchangedByLaterMerges) {
+  View view(ViewDescriptor()
+                .set_measure(kFirstMeasureId)
+                .set_name("sum")
+                .set_aggregation(Aggregation::Sum())
+                .add_column(key1_));
+  Record({{FirstMeasure(), 1.0}}, {{key1_, "value"}});
+  testing::TestUtils::Flush();
+  const ViewData snapshot = view.GetData();
+
+  Record({{FirstMeasure(), 2.0}}, {{key1_, "value"}});
+  testing::TestUtils::Flush();
+  EXPECT_THAT(snapshot.double_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre("value"), 1.0)));
+  EXPECT_THAT(view.GetData().double_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre("value"), 3.0)));
+}
+
+TEST_F(StatsManagerTest, GetRow) {
+  ViewDescriptor view_descriptor = ViewDescriptor()
+                                       .set_measure(kFirstMeasureId)
+                                       .set_name("get_row")
+                                       .set_aggregation(Aggregation::Count())
+                                       .add_column(key1_)
+                                       .add_column(key2_);
+  SetAggregationWindow(AggregationWindow::Delta(), &view_descriptor);
+  View view(view_descriptor);
+  Record({{FirstMeasure(), 1.0}}, {{key1_, "value1"}, {key2_, "value2"}});
+  Record({{FirstMeasure(), 1.0}}, {{key1_, "value1"}, {key2_, "value2"}});
+  Record({{FirstMeasure(), 1.0}}, {{key1_, "value3"}});
+
+  // The active delta is included without an explicit flush.
+  const ViewData row = view.GetRow({"value1", "value2"});
+  ASSERT_EQ(ViewData::Type::kInt64, row.type());
+  EXPECT_THAT(row.int_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(
+                  ::testing::ElementsAre("value1", "value2"), 2)));
+  EXPECT_TRUE(view.GetRow({"value1", ""}).int_data().empty());
+
+  const ViewData rows = view.GetRows(
+      [](const std::vector<std::string>& tag_values) {
+        return tag_values[1].empty();
+      });
+  EXPECT_THAT(rows.int_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(
+                  ::testing::ElementsAre("value3", ""), 1)));
+
+  // Reading rows does not reset Delta-window data.
+  EXPECT_EQ(2, view.GetData().int_data().size());
+}
+
+TEST_F(StatsManagerTest, GetRowInterval) {
+  ViewDescriptor view_descriptor =
+      ViewDescriptor()
+          .set_measure(kFirstMeasureId)
+          .set_name("get_row_interval")
+          .set_aggregation(Aggregation::Distribution(
+              BucketBoundaries::Explicit({10})))
+          .add_column(key1_);
+  SetAggregationWindow(AggregationWindow::Interval(absl::Minutes(1)),
+                       &view_descriptor);
+  View view(view_descriptor);
+  Record({{FirstMeasure(), 5.0}, {FirstMeasure(), 15.0}}, {{key1_, "value1"}});
+  Record({{FirstMeasure(), 5.0}}, {{key1_, "value2"}});
+
+  const ViewData row = view.GetRow({"value1"});
+  ASSERT_EQ(ViewData::Type::kDistribution, row.type());
+  ASSERT_EQ(1, row.distribution_data().size());
+  const Distribution& distribution =
+      row.distribution_data().at(std::vector<std::string>{"value1"});
+  EXPECT_EQ(2, distribution.count());
+  EXPECT_DOUBLE_EQ(10.0, distribution.mean());
+  EXPECT_THAT(distribution.bucket_counts(), ::testing::ElementsAre(1, 1));
+}
+
+TEST_F(StatsManagerTest, MaxRows) {
+  View view(ViewDescriptor()
+                .set_measure(kFirstMeasureId)
+                .set_name("max_rows")
+                .set_aggregation(Aggregation::Count())
+                .add_column(key1_)
+                .set_max_rows(2));
+  Record({{FirstMeasure(), 1.0}}, {{key1_, "value1"}});
+  testing::TestUtils::Flush();
+  for (int i = 0; i < 3; ++i) {
+    Record({{FirstMeasure(), 1.0}}, {{key1_, absl::StrCat("other", i)}});
+  }
+  testing::TestUtils::Flush();
+  const ViewData data = view.GetData();
+  EXPECT_THAT(data.int_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre("value1"), 1),
+                  ::testing::Pair(::testing::ElementsAre(
+                                      ViewDescriptor::kOverflowTagValue),
+                                  3)));
+  EXPECT_EQ(3, data.dropped_tagsets());
+  EXPECT_EQ(3, data.dropped_records());
+
+  // A view with a different limit keeps its own rows.
+  View unlimited_view(ViewDescriptor()
+                          .set_measure(kFirstMeasureId)
+                          .set_name("unlimited")
+                          .set_aggregation(Aggregation::Count())
+                          .add_column(key1_));
+  Record({{FirstMeasure(), 1.0}}, {{key1_, "other0"}});
+  testing::TestUtils::Flush();
+  EXPECT_THAT(unlimited_view.GetData().int_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre("other0"), 1)));
+  // Tag values are counted once however often they are dropped; their
+  // records are counted every time.
+  EXPECT_EQ(3, view.GetData().dropped_tagsets());
+  EXPECT_EQ(4, view.GetData().dropped_records());
+}
+
+TEST_F(StatsManagerTest, ViewWithNewColumn) {
+  View view1(ViewDescriptor()
+                 .set_measure(kFirstMeasureId)
+                 .set_name("count1")
+                 .set_aggregation(Aggregation::Count())
+                 .add_column(key1_));
+  // Only key1 is kept in the delta, so these share a row.
+  Record({{FirstMeasure(), 1.0}}, {{key1_, "value1"}, {key2_, "value2"}});
+  Record({{FirstMeasure(), 1.0}}, {{key1_, "value1"}, {key2_, "value3"}});
+
+  // Data recorded before the view was added, without key2, is not attributed
+  // to it.
+  View view2(ViewDescriptor()
+                 .set_measure(kFirstMeasureId)
+                 .set_name("count2")
+                 .set_aggregation(Aggregation::Count())
+                 .add_column(key2_));
+  Record({{FirstMeasure(), 1.0}}, {{key1_, "value1"}, {key2_, "value2"}});
+  testing::TestUtils::Flush();
+  EXPECT_THAT(view1.GetData().int_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre("value1"), 3)));
+  EXPECT_THAT(view2.GetData().int_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre("value2"), 1)));
+}
+
+TEST_F(StatsManagerTest, ViewsWithChangingAggregations) {
+  const BoundMeasureDouble bound = FirstMeasure().Bind({});
+  View count_view(ViewDescriptor()
+                      .set_measure(kFirstMeasureId)
+                      .set_name("count")
+                      .set_aggregation(Aggregation::Count()));
+  // Only the count is maintained until views need more.
+  Record({{FirstMeasure(), 1.0}});
+  bound.Record(2.0);
+  {
+    View distribution_view(
+        ViewDescriptor()
+            .set_measure(kFirstMeasureId)
+            .set_name("distribution")
+            .set_aggregation(
+                Aggregation::Distribution(BucketBoundaries::Explicit({5}))));
+    Record({{FirstMeasure(), 4.0}});
+    bound.Record(6.0);
+    testing::TestUtils::Flush();
+    const ViewData data = distribution_view.GetData();
+    ASSERT_EQ(1, data.distribution_data().size());
+    const Distribution& distribution = data.distribution_data().begin()->second;
+    EXPECT_EQ(2, distribution.count());
+    EXPECT_DOUBLE_EQ(5, distribution.mean());
+    EXPECT_DOUBLE_EQ(4, distribution.min());
+    EXPECT_DOUBLE_EQ(6, distribution.max());
+    EXPECT_THAT(distribution.bucket_counts(), ::testing::ElementsAre(1, 1));
+  }
+  View sum_view(ViewDescriptor()
+                    .set_measure(kFirstMeasureId)
+                    .set_name("sum")
+                    .set_aggregation(Aggregation::Sum()));
+  Record({{FirstMeasure(), 8.0}});
+  bound.Record(16.0);
+  testing::TestUtils::Flush();
+  EXPECT_THAT(count_view.GetData().int_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre(), 6)));
+  EXPECT_THAT(sum_view.GetData().double_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre(), 24.0)));
+}
+
+TEST_F(StatsManagerTest, BindAfterRemovingView) {
+  View sum_view(ViewDescriptor()
+                    .set_measure(kFirstMeasureId)
+                    .set_name("sum")
+                    .set_aggregation(Aggregation::Sum()));
+  {
+    View distribution_view(
+        ViewDescriptor()
+            .set_measure(kFirstMeasureId)
+            .set_name("distribution")
+            .set_aggregation(
+                Aggregation::Distribution(BucketBoundaries::Explicit({5}))));
+  }
+  // The active delta still maintains all statistics until the next flush, and
+  // so must a cell bound now.
+  const BoundMeasureDouble bound = FirstMeasure().Bind({});
+  bound.Record(3.0);
+  testing::TestUtils::Flush();
+  bound.Record(4.0);
+  testing::TestUtils::Flush();
+  EXPECT_THAT(sum_view.GetData().double_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(::testing::ElementsAre(), 7.0)));
+}
+
+TEST_F(StatsManagerTest, EarlyFlushOnEntryLimit) {
+  ViewDescriptor view_descriptor = ViewDescriptor()
+                                       .set_measure(kFirstMeasureId)
+                                       .set_name("count")
+                                       .set_aggregation(Aggregation::Count())
+                                       .add_column(key1_);
+  View view(view_descriptor);
+
+  DeltaProducer::HarvestOptions options;
+  options.harvest_interval = absl::Hours(1);
+  options.max_harvest_interval = absl::Hours(1);
+  options.max_shard_entries = 10;
+  DeltaProducer::Get()->SetHarvestOptions(options);
+  const uint64_t num_flushes = DeltaProducer::Get()->num_flushes(
+      DeltaProducer::FlushReason::kEntryLimit);
+  for (int i = 0; i < 10; ++i) {
+    Record({{FirstMeasure(), 1.0}}, {{key1_, absl::StrCat("value", i)}});
+  }
+  // The harvester flushes without waiting out the interval.
+  const absl::Time deadline = absl::Now() + absl::Seconds(10);
+  while (DeltaProducer::Get()->num_flushes(
+             DeltaProducer::FlushReason::kEntryLimit) == num_flushes &&
+         absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  DeltaProducer::Get()->SetHarvestOptions(DeltaProducer::HarvestOptions());
+
+  EXPECT_EQ(10, view.GetData().int_data().size());
+}
+
+TEST_F(StatsManagerTest, StretchedHarvestInterval) {
+  DeltaProducer::HarvestOptions options;
+  options.harvest_interval = absl::Milliseconds(1);
+  options.max_harvest_interval = absl::Milliseconds(8);
+  DeltaProducer::Get()->SetHarvestOptions(options);
+  // Harvests find nothing, so the interval doubles up to the maximum.
+  const absl::Time deadline = absl::Now() + absl::Seconds(10);
+  while (DeltaProducer::Get()->harvest_interval() != absl::Milliseconds(8) &&
+         absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  EXPECT_EQ(absl::Milliseconds(8), DeltaProducer::Get()->harvest_interval());
+  DeltaProducer::Get()->SetHarvestOptions(DeltaProducer::HarvestOptions());
+  EXPECT_EQ(absl::Seconds(5), DeltaProducer::Get()->harvest_interval());
+}
+
 TEST(StatsManagerDeathTest, UnregisteredMeasure) {
   const std::string measure_name = "new_measure_name";
   ViewDescriptor view_descriptor = ViewDescriptor()
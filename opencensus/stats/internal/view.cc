@@ -21,6 +21,7 @@
 #include "absl/memory/memory.h"
 #include "absl/time/time.h"
 #include "opencensus/stats/distribution.h"
+#include "opencensus/stats/internal/delta_producer.h"
 #include "opencensus/stats/internal/view_data_impl.h"
 
 namespace opencensus {
@@ -47,5 +48,27 @@ const ViewData View::GetData() {
   return ViewData(handle_->GetData());
 }
 
+const ViewData View::GetRow(const std::vector<std::string>& tag_values) {
+  if (!IsValid()) {
+    std::cerr << "View::GetRow() called on invalid view.\n";
+    ABSL_ASSERT(0);
+    return ViewData(absl::make_unique<ViewDataImpl>(absl::Now(), descriptor_));
+  }
+  // Merge the active delta so that recent records are visible.
+  DeltaProducer::Get()->Flush();
+  return ViewData(handle_->GetRow(tag_values));
+}
+
+const ViewData View::GetRows(
+    const std::function<bool(const std::vector<std::string>&)>& filter) {
+  if (!IsValid()) {
+    std::cerr << "View::GetRows() called on invalid view.\n";
+    ABSL_ASSERT(0);
+    return ViewData(absl::make_unique<ViewDataImpl>(absl::Now(), descriptor_));
+  }
+  DeltaProducer::Get()->Flush();
+  return ViewData(handle_->GetRows(filter));
+}
+
 }  // namespace stats
 }  // namespace opencensus
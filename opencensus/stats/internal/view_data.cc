@@ -81,6 +81,12 @@ const ViewData::DataMap<Distribution>& ViewData::distribution_data() const {
 
 absl::Time ViewData::start_time() const { return impl_->start_time(); }
 absl::Time ViewData::end_time() const { return impl_->end_time(); }
+absl::Time ViewData::row_start_time(
+    const std::vector<std::string>& tag_values) const {
+  return impl_->row_start_time(tag_values);
+}
+int64_t ViewData::dropped_tagsets() const { return impl_->dropped_tagsets(); }
+int64_t ViewData::dropped_records() const { return impl_->dropped_records(); }
 
 ViewData::ViewData(const ViewData& other)
     : impl_(absl::make_unique<ViewDataImpl>(*other.impl_)) {}
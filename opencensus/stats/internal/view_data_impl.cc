@@ -14,12 +14,18 @@
 
 #include "opencensus/stats/internal/view_data_impl.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/base/macros.h"
 #include "absl/memory/memory.h"
+#include "opencensus/common/internal/string_vector_hash.h"
 #include "opencensus/stats/distribution.h"
 #include "opencensus/stats/measure_descriptor.h"
 #include "opencensus/stats/view_descriptor.h"
@@ -27,6 +33,25 @@
 namespace opencensus {
 namespace stats {
 
+namespace {
+
+// The size of the sketch of dropped tagsets.
+constexpr int kDroppedTagsetBitsLog2 = 15;
+constexpr int kDroppedTagsetBits = 1 << kDroppedTagsetBitsLog2;
+
+// Returns the type 'data' is exported as: interval data is converted to
+// doubles or distributions.
+ViewDataImpl::Type ExportType(const ViewDataImpl& data) {
+  if (data.type() != ViewDataImpl::Type::kStatsObject) {
+    return data.type();
+  }
+  return data.aggregation().type() == Aggregation::Type::kDistribution
+             ? ViewDataImpl::Type::kDistribution
+             : ViewDataImpl::Type::kDouble;
+}
+
+}  // namespace
+
 ViewDataImpl::Type ViewDataImpl::TypeForDescriptor(
     const ViewDescriptor& descriptor) {
   switch (descriptor.aggregation_window_.type()) {
@@ -58,59 +83,122 @@ ViewDataImpl::ViewDataImpl(absl::Time start_time,
     : aggregation_(descriptor.aggregation()),
       aggregation_window_(descriptor.aggregation_window_),
       type_(TypeForDescriptor(descriptor)),
-      start_time_(start_time) {
+      max_rows_(descriptor.max_rows()),
+      start_time_(start_time),
+      row_ttl_(descriptor.row_ttl()),
+      next_expiry_check_(start_time + row_ttl_ / 4),
+      last_expiry_(start_time) {
+  if (aggregation_window_.type() == AggregationWindow::Type::kCumulative &&
+      row_ttl_ != absl::InfiniteDuration()) {
+    row_times_ = std::make_shared<DataMap<RowTimes>>();
+  }
   switch (type_) {
     case Type::kDouble: {
-      new (&double_data_) DataMap<double>();
+      new (&double_data_) std::shared_ptr<DataMap<double>>(
+          std::make_shared<DataMap<double>>());
       break;
     }
     case Type::kInt64: {
-      new (&int_data_) DataMap<int64_t>();
+      new (&int_data_) std::shared_ptr<DataMap<int64_t>>(
+          std::make_shared<DataMap<int64_t>>());
       break;
     }
     case Type::kDistribution: {
-      new (&distribution_data_) DataMap<Distribution>();
+      new (&distribution_data_) std::shared_ptr<DataMap<Distribution>>(
+          std::make_shared<DataMap<Distribution>>());
       break;
     }
     case Type::kStatsObject: {
-      new (&interval_data_) DataMap<IntervalStatsObject>();
+      new (&interval_data_) std::shared_ptr<DataMap<IntervalRow>>(
+          std::make_shared<DataMap<IntervalRow>>());
       break;
     }
   }
 }
 
 ViewDataImpl::ViewDataImpl(const ViewDataImpl& other, absl::Time now)
+    : ViewDataImpl(other, now, ExportType(other)) {
+  ABSL_ASSERT(aggregation_window_.type() == AggregationWindow::Type::kInterval);
+  for (const auto& row : other.interval_data()) {
+    AddIntervalRow(row.first, row.second, now);
+  }
+}
+
+ViewDataImpl::ViewDataImpl(const ViewDataImpl& other, absl::Time now,
+                           Type type)
     : aggregation_(other.aggregation()),
       aggregation_window_(other.aggregation_window()),
-      type_(other.aggregation().type() == Aggregation::Type::kDistribution
-                ? Type::kDistribution
-                : Type::kDouble),
-      start_time_(std::max(other.start_time(),
-                           now - other.aggregation_window().duration())),
-      end_time_(now) {
-  ABSL_ASSERT(aggregation_window_.type() == AggregationWindow::Type::kInterval);
+      type_(type),
+      max_rows_(other.max_rows_),
+      start_time_(other.type() == Type::kStatsObject
+                      ? std::max(other.start_time(),
+                                 now - other.aggregation_window().duration())
+                      : other.start_time()),
+      end_time_(other.type() == Type::kStatsObject ? now : other.end_time()),
+      dropped_tagset_bits_(other.dropped_tagset_bits_),
+      dropped_tagset_bits_set_(other.dropped_tagset_bits_set_),
+      dropped_records_(other.dropped_records_),
+      row_ttl_(other.row_ttl_),
+      next_expiry_check_(other.next_expiry_check_),
+      last_expiry_(other.last_expiry_) {
+  if (other.row_times_ != nullptr) {
+    row_times_ = std::make_shared<DataMap<RowTimes>>();
+  }
+  switch (type_) {
+    case Type::kDouble: {
+      new (&double_data_) std::shared_ptr<DataMap<double>>(
+          std::make_shared<DataMap<double>>());
+      break;
+    }
+    case Type::kInt64: {
+      new (&int_data_) std::shared_ptr<DataMap<int64_t>>(
+          std::make_shared<DataMap<int64_t>>());
+      break;
+    }
+    case Type::kDistribution: {
+      new (&distribution_data_) std::shared_ptr<DataMap<Distribution>>(
+          std::make_shared<DataMap<Distribution>>());
+      break;
+    }
+    case Type::kStatsObject: {
+      std::cerr << "Rows cannot be copied into interval stats.\n";
+      ABSL_ASSERT(0);
+      new (&interval_data_) std::shared_ptr<DataMap<IntervalRow>>(
+          std::make_shared<DataMap<IntervalRow>>());
+      break;
+    }
+  }
+}
+
+void ViewDataImpl::AddIntervalRow(const std::vector<std::string>& tag_values,
+                                  const IntervalRow& row, absl::Time now) {
+  const IntervalStatsObject& stats = row.stats;
   switch (aggregation_.type()) {
     case Aggregation::Type::kSum:
     case Aggregation::Type::kCount: {
-      new (&double_data_) DataMap<double>();
-      for (const auto& row : other.interval_data()) {
-        row.second.SumInto(absl::Span<double>(&double_data_[row.first], 1),
-                           now);
-      }
+      stats.SumInto(absl::Span<double>(&(*double_data_)[tag_values], 1), now);
       break;
     }
     case Aggregation::Type::kDistribution: {
-      new (&distribution_data_) DataMap<Distribution>();
-      for (const auto& row : other.interval_data()) {
-        const std::pair<DataMap<Distribution>::iterator, bool>& it =
-            distribution_data_.emplace(
-                row.first, Distribution(&aggregation_.bucket_boundaries()));
-        Distribution& distribution = it.first->second;
-        row.second.DistributionInto(
-            &distribution.count_, &distribution.mean_,
-            &distribution.sum_of_squared_deviation_, &distribution.min_,
-            &distribution.max_,
-            absl::Span<uint64_t>(distribution.bucket_counts_), now);
+      const std::pair<DataMap<Distribution>::iterator, bool>& it =
+          distribution_data_->emplace(
+              tag_values, Distribution(&aggregation_.bucket_boundaries()));
+      Distribution& distribution = it.first->second;
+      const bool auto_ranging =
+          aggregation_.bucket_boundaries().auto_ranging();
+      const int num_buckets = stats.num_stats() - 5;
+      if (auto_ranging && num_buckets > 0) {
+        distribution.ExtendBuckets(row.first_bucket,
+                                   row.first_bucket + num_buckets);
+      }
+      stats.DistributionInto(
+          &distribution.count_, &distribution.mean_,
+          &distribution.sum_of_squared_deviation_, &distribution.min_,
+          &distribution.max_,
+          absl::Span<uint64_t>(distribution.bucket_counts_), now);
+      if (auto_ranging) {
+        // Buckets populated only in expired windows are now empty.
+        distribution.TrimBuckets();
       }
       break;
     }
@@ -121,22 +209,99 @@ ViewDataImpl::ViewDataImpl(const ViewDataImpl& other, absl::Time now)
   }
 }
 
+std::unique_ptr<ViewDataImpl> ViewDataImpl::GetRows(
+    const std::function<bool(const std::vector<std::string>&)>& filter,
+    absl::Time now) const {
+  // Need to use WrapUnique because this is a private constructor.
+  auto rows = absl::WrapUnique(new ViewDataImpl(*this, now, ExportType(*this)));
+  auto add_matching_rows = [&](const std::vector<std::string>& tag_values) {
+    if (filter(tag_values)) {
+      rows->AddRowFrom(*this, tag_values, now);
+    }
+  };
+  switch (type_) {
+    case Type::kDouble:
+      for (const auto& row : *double_data_) add_matching_rows(row.first);
+      break;
+    case Type::kInt64:
+      for (const auto& row : *int_data_) add_matching_rows(row.first);
+      break;
+    case Type::kDistribution:
+      for (const auto& row : *distribution_data_) add_matching_rows(row.first);
+      break;
+    case Type::kStatsObject:
+      for (const auto& row : *interval_data_) add_matching_rows(row.first);
+      break;
+  }
+  return rows;
+}
+
+std::unique_ptr<ViewDataImpl> ViewDataImpl::GetRow(
+    const std::vector<std::string>& tag_values, absl::Time now) const {
+  auto rows = absl::WrapUnique(new ViewDataImpl(*this, now, ExportType(*this)));
+  rows->AddRowFrom(*this, tag_values, now);
+  return rows;
+}
+
+void ViewDataImpl::AddRowFrom(const ViewDataImpl& other,
+                              const std::vector<std::string>& tag_values,
+                              absl::Time now) {
+  switch (other.type_) {
+    case Type::kDouble: {
+      const auto it = other.double_data_->find(tag_values);
+      if (it != other.double_data_->end()) {
+        double_data_->insert(*it);
+      }
+      break;
+    }
+    case Type::kInt64: {
+      const auto it = other.int_data_->find(tag_values);
+      if (it != other.int_data_->end()) {
+        int_data_->insert(*it);
+      }
+      break;
+    }
+    case Type::kDistribution: {
+      const auto it = other.distribution_data_->find(tag_values);
+      if (it != other.distribution_data_->end()) {
+        distribution_data_->insert(*it);
+      }
+      break;
+    }
+    case Type::kStatsObject: {
+      const auto it = other.interval_data_->find(tag_values);
+      if (it != other.interval_data_->end()) {
+        AddIntervalRow(tag_values, it->second, now);
+      }
+      break;
+    }
+  }
+  if (row_times_ != nullptr) {
+    const auto it = other.row_times_->find(tag_values);
+    if (it != other.row_times_->end()) {
+      RowTimes times = it->second;
+      times.data = FindData(tag_values);
+      row_times_->emplace(tag_values, times);
+    }
+  }
+}
+
 ViewDataImpl::~ViewDataImpl() {
   switch (type_) {
     case Type::kDouble: {
-      double_data_.~DataMap<double>();
+      double_data_.~shared_ptr<DataMap<double>>();
       break;
     }
     case Type::kInt64: {
-      int_data_.~DataMap<int64_t>();
+      int_data_.~shared_ptr<DataMap<int64_t>>();
       break;
     }
     case Type::kDistribution: {
-      distribution_data_.~DataMap<Distribution>();
+      distribution_data_.~shared_ptr<DataMap<Distribution>>();
       break;
     }
     case Type::kStatsObject: {
-      interval_data_.~DataMap<IntervalStatsObject>();
+      interval_data_.~shared_ptr<DataMap<IntervalRow>>();
       break;
     }
   }
@@ -151,19 +316,29 @@ ViewDataImpl::ViewDataImpl(const ViewDataImpl& other)
     : aggregation_(other.aggregation_),
       aggregation_window_(other.aggregation_window_),
       type_(other.type()),
+      max_rows_(other.max_rows_),
       start_time_(other.start_time_),
-      end_time_(other.end_time_) {
+      end_time_(other.end_time_),
+      dropped_tagset_bits_(other.dropped_tagset_bits_),
+      dropped_tagset_bits_set_(other.dropped_tagset_bits_set_),
+      dropped_records_(other.dropped_records_),
+      row_ttl_(other.row_ttl_),
+      row_times_(other.row_times_),
+      next_expiry_check_(other.next_expiry_check_),
+      last_expiry_(other.last_expiry_) {
   switch (type_) {
+    // Shares the data until either copy is modified.
     case Type::kDouble: {
-      new (&double_data_) DataMap<double>(other.double_data_);
+      new (&double_data_) std::shared_ptr<DataMap<double>>(other.double_data_);
       break;
     }
     case Type::kInt64: {
-      new (&int_data_) DataMap<int64_t>(other.int_data_);
+      new (&int_data_) std::shared_ptr<DataMap<int64_t>>(other.int_data_);
       break;
     }
     case Type::kDistribution: {
-      new (&distribution_data_) DataMap<Distribution>(other.distribution_data_);
+      new (&distribution_data_) std::shared_ptr<DataMap<Distribution>>(
+          other.distribution_data_);
       break;
     }
     case Type::kStatsObject: {
@@ -178,29 +353,280 @@ ViewDataImpl::ViewDataImpl(const ViewDataImpl& other)
 
 void ViewDataImpl::Merge(const std::vector<std::string>& tag_values,
                          const MeasureData& data, absl::Time now) {
+  MergeRow(FindOrAddRow(tag_values, now), data, now);
+}
+
+void ViewDataImpl::MakeWritable() {
+  bool copied = false;
+  switch (type_) {
+    case Type::kDouble:
+      copied = Unshare(&double_data_);
+      break;
+    case Type::kInt64:
+      copied = Unshare(&int_data_);
+      break;
+    case Type::kDistribution:
+      copied = Unshare(&distribution_data_);
+      break;
+    case Type::kStatsObject:
+      // Interval data is never shared, since it cannot be copied.
+      break;
+  }
+  if (row_times_ == nullptr) {
+    return;
+  }
+  // Copies may drop their references between the checks of the data and
+  // row_times_, so the two use counts need not agree: row_times_ is copied if
+  // either is shared, and remapped to the rows of the data if that was copied.
+  if (copied || row_times_.use_count() > 1) {
+    row_times_ = std::make_shared<DataMap<RowTimes>>(*row_times_);
+  }
+  if (copied) {
+    for (auto& row : *row_times_) {
+      row.second.data = FindData(row.first);
+    }
+  }
+}
+
+template <typename DataValueT>
+bool ViewDataImpl::Unshare(std::shared_ptr<DataMap<DataValueT>>* data) {
+  // Other owners only ever drop their references concurrently, so at worst
+  // this copies data that has just stopped being shared.
+  if (data->use_count() > 1) {
+    *data = std::make_shared<DataMap<DataValueT>>(**data);
+    ++generation_;
+    return true;
+  }
+  return false;
+}
+
+size_t ViewDataImpl::num_rows() const {
+  switch (type_) {
+    case Type::kDouble:
+      return double_data_->size();
+    case Type::kInt64:
+      return int_data_->size();
+    case Type::kDistribution:
+      return distribution_data_->size();
+    case Type::kStatsObject:
+      return interval_data_->size();
+  }
+  return 0;
+}
+
+ViewDataImpl::Row ViewDataImpl::FindData(
+    const std::vector<std::string>& tag_values) const {
+  switch (type_) {
+    case Type::kDouble: {
+      const auto it = double_data_->find(tag_values);
+      return it == double_data_->end() ? nullptr : &it->second;
+    }
+    case Type::kInt64: {
+      const auto it = int_data_->find(tag_values);
+      return it == int_data_->end() ? nullptr : &it->second;
+    }
+    case Type::kDistribution: {
+      const auto it = distribution_data_->find(tag_values);
+      return it == distribution_data_->end() ? nullptr : &it->second;
+    }
+    case Type::kStatsObject: {
+      const auto it = interval_data_->find(tag_values);
+      return it == interval_data_->end() ? nullptr : &it->second;
+    }
+  }
+  return nullptr;
+}
+
+void ViewDataImpl::EraseData(const std::vector<std::string>& tag_values) {
+  switch (type_) {
+    case Type::kDouble:
+      double_data_->erase(tag_values);
+      break;
+    case Type::kInt64:
+      int_data_->erase(tag_values);
+      break;
+    case Type::kDistribution:
+      distribution_data_->erase(tag_values);
+      break;
+    case Type::kStatsObject:
+      interval_data_->erase(tag_values);
+      break;
+  }
+}
+
+absl::Time ViewDataImpl::row_start_time(
+    const std::vector<std::string>& tag_values) const {
+  if (row_times_ == nullptr) {
+    return start_time_;
+  }
+  const auto it = row_times_->find(tag_values);
+  return it == row_times_->end() ? start_time_ : it->second.start_time;
+}
+
+ViewDataImpl::Row ViewDataImpl::FindOrAddRow(
+    const std::vector<std::string>& tag_values, absl::Time now) {
+  MakeWritable();
+  if (max_rows_ == 0 || num_rows() + 1 < max_rows_ ||
+      FindData(tag_values) != nullptr) {
+    return FindOrAddRowUnlimited(tag_values, now);
+  }
+  std::vector<std::string> overflow_tag_values(
+      tag_values.size(), ViewDescriptor::kOverflowTagValue);
+  // One of the max_rows_ rows is reserved for the overflow row.
+  if (num_rows() < max_rows_ && FindData(overflow_tag_values) != nullptr) {
+    return FindOrAddRowUnlimited(tag_values, now);
+  }
+  AddDroppedTagset(tag_values);
+  overflow_row_ = FindOrAddRowUnlimited(overflow_tag_values, now);
+  overflow_row_generation_ = generation_;
+  return overflow_row_;
+}
+
+void ViewDataImpl::AddDroppedTagset(
+    const std::vector<std::string>& tag_values) {
+  if (dropped_tagset_bits_ == nullptr) {
+    dropped_tagset_bits_ =
+        std::make_shared<std::vector<uint64_t>>(kDroppedTagsetBits / 64);
+  } else if (dropped_tagset_bits_.use_count() > 1) {
+    // A snapshot shares the bits.
+    dropped_tagset_bits_ =
+        std::make_shared<std::vector<uint64_t>>(*dropped_tagset_bits_);
+  }
+  // Multiplicative hashing spreads the hash over the top bits.
+  const uint64_t bit =
+      (static_cast<uint64_t>(common::StringVectorHash()(tag_values)) *
+       0x9E3779B97F4A7C15ull) >>
+      (64 - kDroppedTagsetBitsLog2);
+  uint64_t& word = (*dropped_tagset_bits_)[bit / 64];
+  const uint64_t mask = uint64_t{1} << (bit % 64);
+  if ((word & mask) == 0) {
+    word |= mask;
+    ++dropped_tagset_bits_set_;
+  }
+}
+
+int64_t ViewDataImpl::dropped_tagsets() const {
+  if (dropped_tagset_bits_set_ == 0) {
+    return 0;
+  }
+  // The expected number of distinct values setting this many bits. Once all
+  // bits are set, the estimate saturates.
+  const double num_bits = kDroppedTagsetBits;
+  const double bits_set =
+      std::min<double>(dropped_tagset_bits_set_, num_bits - 1);
+  return std::llround(-num_bits * std::log1p(-bits_set / num_bits));
+}
+
+ViewDataImpl::Row ViewDataImpl::FindOrAddRowUnlimited(
+    const std::vector<std::string>& tag_values, absl::Time now) {
+  const Row data = FindOrAddData(tag_values, now);
+  if (row_times_ == nullptr) {
+    return data;
+  }
+  DataMap<RowTimes>::iterator it = row_times_->find(tag_values);
+  if (it == row_times_->end()) {
+    it = row_times_->emplace_hint(it, tag_values,
+                                  RowTimes{last_expiry_, now, data});
+  }
+  return &it->second;
+}
+
+void ViewDataImpl::ExpireRows(absl::Time now) {
+  if (row_times_ == nullptr || now < next_expiry_check_) {
+    return;
+  }
+  next_expiry_check_ = now + row_ttl_ / 4;
+  const absl::Time cutoff = now - row_ttl_;
+  const auto expired = [cutoff](const DataMap<RowTimes>::value_type& row) {
+    return row.second.last_update < cutoff;
+  };
+  if (std::none_of(row_times_->begin(), row_times_->end(), expired)) {
+    return;
+  }
+  MakeWritable();
+  for (auto it = row_times_->begin(); it != row_times_->end();) {
+    if (expired(*it)) {
+      EraseData(it->first);
+      it = row_times_->erase(it);
+    } else {
+      ++it;
+    }
+  }
+  last_expiry_ = now;
+  ++generation_;
+}
+
+ViewDataImpl::Row ViewDataImpl::FindOrAddData(
+    const std::vector<std::string>& tag_values, absl::Time now) {
+  switch (type_) {
+    case Type::kDouble:
+      return &(*double_data_)[tag_values];
+    case Type::kInt64:
+      return &(*int_data_)[tag_values];
+    case Type::kDistribution: {
+      DataMap<Distribution>::iterator it =
+          distribution_data_->find(tag_values);
+      if (it == distribution_data_->end()) {
+        it = distribution_data_->emplace_hint(
+            it, tag_values, Distribution(&aggregation_.bucket_boundaries()));
+      }
+      return &it->second;
+    }
+    case Type::kStatsObject: {
+      DataMap<IntervalRow>::iterator it = interval_data_->find(tag_values);
+      if (it == interval_data_->end()) {
+        const BucketBoundaries& buckets = aggregation_.bucket_boundaries();
+        // Auto-ranging histograms start empty and grow as buckets are
+        // populated.
+        const int num_stats =
+            aggregation_.type() == Aggregation::Type::kDistribution
+                ? (buckets.auto_ranging() ? 0 : buckets.num_buckets()) + 5
+                : 1;
+        it = interval_data_->emplace_hint(
+            it, std::piecewise_construct, std::make_tuple(tag_values),
+            std::make_tuple(num_stats, aggregation_window_.duration(), now));
+      }
+      return &it->second;
+    }
+  }
+  ABSL_ASSERT(false && "Invalid ViewDataImpl type.");
+  return nullptr;
+}
+
+void ViewDataImpl::MergeRow(Row row, const MeasureData& data, absl::Time now) {
   end_time_ = std::max(end_time_, now);
+  if (row == overflow_row_ && generation_ == overflow_row_generation_) {
+    dropped_records_ += data.count();
+  }
+  if (row_times_ != nullptr) {
+    RowTimes* times = static_cast<RowTimes*>(row);
+    times->last_update = std::max(times->last_update, now);
+    row = times->data;
+  }
   switch (type_) {
     case Type::kDouble: {
+      double& value = *static_cast<double*>(row);
       if (aggregation_.type() == Aggregation::Type::kSum) {
-        double_data_[tag_values] += data.sum();
+        value += data.sum();
       } else {
         ABSL_ASSERT(aggregation_.type() == Aggregation::Type::kLastValue);
-        double_data_[tag_values] = data.last_value();
+        value = data.last_value();
       }
       break;
     }
     case Type::kInt64: {
+      int64_t& value = *static_cast<int64_t*>(row);
       switch (aggregation_.type()) {
         case Aggregation::Type::kCount: {
-          int_data_[tag_values] += data.count();
+          value += data.count();
           break;
         }
         case Aggregation::Type::kSum: {
-          int_data_[tag_values] += data.sum();
+          value += data.sum();
           break;
         }
         case Aggregation::Type::kLastValue: {
-          int_data_[tag_values] = data.last_value();
+          value = data.last_value();
           break;
         }
         default:
@@ -209,65 +635,93 @@ void ViewDataImpl::Merge(const std::vector<std::string>& tag_values,
       break;
     }
     case Type::kDistribution: {
-      DataMap<Distribution>::iterator it = distribution_data_.find(tag_values);
-      if (it == distribution_data_.end()) {
-        it = distribution_data_.emplace_hint(
-            it, tag_values, Distribution(&aggregation_.bucket_boundaries()));
+      Distribution* distribution = static_cast<Distribution*>(row);
+      data.AddToDistribution(distribution);
+      if (aggregation_.max_buckets_per_row() > 0) {
+        distribution->CollapseBuckets(aggregation_.max_buckets_per_row());
       }
-      data.AddToDistribution(&it->second);
       break;
     }
     case Type::kStatsObject: {
-      DataMap<IntervalStatsObject>::iterator it =
-          interval_data_.find(tag_values);
+      IntervalRow* interval_row = static_cast<IntervalRow*>(row);
+      IntervalStatsObject& stats = interval_row->stats;
       if (aggregation_.type() == Aggregation::Type::kDistribution) {
-        const auto& buckets = aggregation_.bucket_boundaries();
-        if (it == interval_data_.end()) {
-          it = interval_data_.emplace_hint(
-              it, std::piecewise_construct, std::make_tuple(tag_values),
-              std::make_tuple(buckets.num_buckets() + 5,
-                              aggregation_window_.duration(), now));
-        }
-        auto window = it->second.MutableCurrentBucket(now);
-        data.AddToDistribution(
-            buckets, &window[0], &window[1], &window[2], &window[3], &window[4],
-            absl::Span<double>(&window[5], buckets.num_buckets()));
+        MergeIntervalDistribution(data, interval_row, now);
+      } else if (aggregation_ == Aggregation::Count()) {
+        stats.MutableCurrentBucket(now)[0] += data.count();
       } else {
-        if (it == interval_data_.end()) {
-          it = interval_data_.emplace_hint(
-              it, std::piecewise_construct, std::make_tuple(tag_values),
-              std::make_tuple(1, aggregation_window_.duration(), now));
-        }
-        if (aggregation_ == Aggregation::Count()) {
-          it->second.MutableCurrentBucket(now)[0] += data.count();
-        } else {
-          it->second.MutableCurrentBucket(now)[0] += data.sum();
-        }
+        stats.MutableCurrentBucket(now)[0] += data.sum();
       }
       break;
     }
   }
 }
 
+void ViewDataImpl::MergeIntervalDistribution(const MeasureData& data,
+                                             IntervalRow* row,
+                                             absl::Time now) {
+  const BucketBoundaries& buckets = aggregation_.bucket_boundaries();
+  IntervalStatsObject& stats = row->stats;
+  if (buckets.auto_ranging()) {
+    // Grow the windows' histograms to cover the buckets 'data' populates.
+    const std::pair<int, int> range = data.bucket_range(buckets);
+    if (range.first < range.second) {
+      if (stats.num_stats() == 5) {
+        row->first_bucket = range.first;
+      } else if (range.first < row->first_bucket) {
+        stats.InsertStats(5, row->first_bucket - range.first);
+        row->first_bucket = range.first;
+      }
+      const int end = row->first_bucket + stats.num_stats() - 5;
+      if (range.second > end) {
+        stats.InsertStats(stats.num_stats(), range.second - end);
+      }
+    }
+  }
+  const absl::Span<double> window = stats.MutableCurrentBucket(now);
+  data.AddToDistribution(
+      buckets, &window[0], &window[1], &window[2], &window[3], &window[4],
+      absl::Span<double>(window.data() + 5, window.size() - 5),
+      row->first_bucket);
+  const int max_buckets = aggregation_.max_buckets_per_row();
+  const int excess = static_cast<int>(stats.num_stats()) - 5 - max_buckets;
+  if (max_buckets > 0 && excess > 0) {
+    // As in Distribution::CollapseBuckets(), the lowest buckets are merged
+    // into one, here in every window.
+    stats.CollapseStats(5, 5 + excess + 1);
+    row->first_bucket += excess;
+  }
+}
+
 ViewDataImpl::ViewDataImpl(ViewDataImpl* source, absl::Time now)
     : aggregation_(source->aggregation_),
       aggregation_window_(source->aggregation_window_),
       type_(source->type_),
+      max_rows_(source->max_rows_),
       start_time_(source->start_time_),
-      end_time_(now) {
+      end_time_(now),
+      dropped_tagset_bits_(std::move(source->dropped_tagset_bits_)),
+      dropped_tagset_bits_set_(source->dropped_tagset_bits_set_),
+      dropped_records_(source->dropped_records_),
+      row_ttl_(source->row_ttl_),
+      next_expiry_check_(source->next_expiry_check_),
+      last_expiry_(source->last_expiry_) {
   switch (type_) {
     case Type::kDouble: {
-      new (&double_data_) DataMap<double>();
+      new (&double_data_) std::shared_ptr<DataMap<double>>(
+          std::make_shared<DataMap<double>>());
       double_data_.swap(source->double_data_);
       break;
     }
     case Type::kInt64: {
-      new (&int_data_) DataMap<int64_t>();
+      new (&int_data_) std::shared_ptr<DataMap<int64_t>>(
+          std::make_shared<DataMap<int64_t>>());
       int_data_.swap(source->int_data_);
       break;
     }
     case Type::kDistribution: {
-      new (&distribution_data_) DataMap<Distribution>();
+      new (&distribution_data_) std::shared_ptr<DataMap<Distribution>>(
+          std::make_shared<DataMap<Distribution>>());
       distribution_data_.swap(source->distribution_data_);
       break;
     }
@@ -280,6 +734,10 @@ ViewDataImpl::ViewDataImpl(ViewDataImpl* source, absl::Time now)
   }
   source->start_time_ = now;
   source->end_time_ = now;
+  source->dropped_tagset_bits_.reset();
+  source->dropped_tagset_bits_set_ = 0;
+  source->dropped_records_ = 0;
+  ++source->generation_;
 }
 
 }  // namespace stats
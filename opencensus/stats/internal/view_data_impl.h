@@ -15,6 +15,8 @@
 #ifndef OPENCENSUS_STATS_INTERNAL_VIEW_DATA_IMPL_H_
 #define OPENCENSUS_STATS_INTERNAL_VIEW_DATA_IMPL_H_
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -50,6 +52,16 @@ class ViewDataImpl {
   // opencensus/common/internal/stats_object.h for details)--this balances the
   // precision of estimates against resource use.
   typedef common::StatsObject<4> IntervalStatsObject;
+  // The data of a row of an interval view.
+  struct IntervalRow {
+    IntervalRow(uint16_t num_stats, absl::Duration interval, absl::Time now)
+        : stats(num_stats, interval, now) {}
+
+    IntervalStatsObject stats;
+    // For auto-ranging bucket boundaries, 'stats' holds only the histogram
+    // buckets populated in the row so far, starting with 'first_bucket'.
+    int first_bucket = 0;
+  };
 
   // Constructs an empty ViewDataImpl for internal use from the descriptor. A
   // ViewData can be constructed directly from such a ViewDataImpl for
@@ -68,6 +80,17 @@ class ViewDataImpl {
   // start_time().
   std::unique_ptr<ViewDataImpl> GetDeltaAndReset(absl::Time now);
 
+  // Returns a snapshot at 'now' holding only the rows whose tag values satisfy
+  // 'filter', converting interval data like ViewDataImpl(other, now). Unlike
+  // GetDeltaAndReset(), this does not reset the data.
+  std::unique_ptr<ViewDataImpl> GetRows(
+      const std::function<bool(const std::vector<std::string>&)>& filter,
+      absl::Time now) const;
+  // Returns a snapshot at 'now' holding only the row for 'tag_values', if it
+  // exists, found without scanning the other rows.
+  std::unique_ptr<ViewDataImpl> GetRow(
+      const std::vector<std::string>& tag_values, absl::Time now) const;
+
   const Aggregation& aggregation() const { return aggregation_; }
   const AggregationWindow& aggregation_window() const {
     return aggregation_window_;
@@ -88,24 +111,40 @@ class ViewDataImpl {
   // type());
   const DataMap<double>& double_data() const {
     ABSL_ASSERT(type_ == Type::kDouble);
-    return double_data_;
+    return *double_data_;
   }
   const DataMap<int64_t>& int_data() const {
     ABSL_ASSERT(type_ == Type::kInt64);
-    return int_data_;
+    return *int_data_;
   }
   const DataMap<Distribution>& distribution_data() const {
     ABSL_ASSERT(type_ == Type::kDistribution);
-    return distribution_data_;
+    return *distribution_data_;
   }
-  const DataMap<IntervalStatsObject>& interval_data() const {
+  const DataMap<IntervalRow>& interval_data() const {
     ABSL_ASSERT(type_ == Type::kStatsObject);
-    return interval_data_;
+    return *interval_data_;
   }
 
   absl::Time start_time() const { return start_time_; }
   absl::Time end_time() const { return end_time_; }
 
+  // The number of rows, including the overflow row.
+  size_t num_rows() const;
+  // An estimate of the number of distinct tag values that FindOrAddRow()
+  // redirected to the overflow row since the last GetDeltaAndReset(). Counts
+  // up to a few hundred are exact with high probability; the estimate
+  // saturates at about 340,000.
+  int64_t dropped_tagsets() const;
+  // The exact number of measurements for tag values without a row of their
+  // own that were merged into the overflow row since the last
+  // GetDeltaAndReset().
+  int64_t dropped_records() const { return dropped_records_; }
+  // Returns when the row for 'tag_values' started accumulating data. For views
+  // with a row TTL this is when rows last expired before the row was added,
+  // since it may continue an expired row; otherwise it is start_time().
+  absl::Time row_start_time(const std::vector<std::string>& tag_values) const;
+
   // Merges bulk data for the given tag values at 'now'. tag_values must be
   // ordered according to the order of keys in the ViewDescriptor.
   // TODO: Change to take Span<string_view> when heterogenous lookup is
@@ -113,25 +152,117 @@ class ViewDataImpl {
   void Merge(const std::vector<std::string>& tag_values,
              const MeasureData& data, absl::Time now);
 
+  // A handle to the data for one set of tag values, for merging into it
+  // repeatedly without looking up the tag values again. Rows are invalidated
+  // whenever generation() changes.
+  typedef void* Row;
+
+  // Copies the data if a copy of this ViewDataImpl still shares it, so that
+  // it can be modified. Must be called before writing to rows from an earlier
+  // FindOrAddRow(), and increments generation() if it copies.
+  void MakeWritable();
+
+  // Returns the row for 'tag_values', adding an empty row at 'now' if needed.
+  // tag_values must be ordered as for Merge(). If adding a row would leave no
+  // room for the overflow row within the descriptor's max_rows(), returns the
+  // overflow row instead.
+  // For views with a row TTL, merging into the row renews it.
+  Row FindOrAddRow(const std::vector<std::string>& tag_values, absl::Time now);
+  // Merges bulk data into 'row' at 'now'.
+  void MergeRow(Row row, const MeasureData& data, absl::Time now);
+
+  // Drops the rows of a view with a row TTL that were last merged into
+  // before 'now' - row_ttl(). Checks at most once every row_ttl() / 4.
+  void ExpireRows(absl::Time now);
+
+  // Incremented whenever rows are invalidated, by GetDeltaAndReset(),
+  // ExpireRows(), or MakeWritable() copying the data.
+  uint64_t generation() const { return generation_; }
+
  private:
   // Implements GetDeltaAndReset(), copying aggregation_ and swapping data_ and
   // start/end times. This is private so that it can be given a more descriptive
   // name in the public API.
   ViewDataImpl(ViewDataImpl* source, absl::Time now);
 
+  // Constructs an empty ViewDataImpl with no data, to hold rows selected from
+  // 'other' as of 'now'.
+  ViewDataImpl(const ViewDataImpl& other, absl::Time now, Type type);
+
   Type TypeForDescriptor(const ViewDescriptor& descriptor);
 
+  // When a row was added and last merged into, for views with a row TTL.
+  struct RowTimes {
+    absl::Time start_time;
+    absl::Time last_update;
+    // The row's entry in the data.
+    Row data;
+  };
+
+  // Returns the row's entry in the data, or nullptr if there is none.
+  Row FindData(const std::vector<std::string>& tag_values) const;
+  Row FindOrAddData(const std::vector<std::string>& tag_values,
+                    absl::Time now);
+  void EraseData(const std::vector<std::string>& tag_values);
+  // Implements FindOrAddRow() without the row limit.
+  Row FindOrAddRowUnlimited(const std::vector<std::string>& tag_values,
+                            absl::Time now);
+
+  // Adds the row 'tag_values' of 'other', if it has one, converting interval
+  // data as of 'now'.
+  void AddRowFrom(const ViewDataImpl& other,
+                  const std::vector<std::string>& tag_values, absl::Time now);
+  // Adds the interval data 'row' under 'tag_values' as of 'now'.
+  void AddIntervalRow(const std::vector<std::string>& tag_values,
+                      const IntervalRow& row, absl::Time now);
+  // Merges 'data' into the interval distribution 'row' at 'now'.
+  void MergeIntervalDistribution(const MeasureData& data, IntervalRow* row,
+                                 absl::Time now);
+
+  // Adds 'tag_values' to dropped_tagset_bits_.
+  void AddDroppedTagset(const std::vector<std::string>& tag_values);
+
+  // Replaces '*data' with a copy of itself if it is shared, returning whether
+  // it did.
+  template <typename DataValueT>
+  bool Unshare(std::shared_ptr<DataMap<DataValueT>>* data);
+
   const Aggregation aggregation_;
   const AggregationWindow aggregation_window_;
   const Type type_;
+  // The row limit, or 0 for none.
+  const size_t max_rows_;
+  // The data is shared between copies until one of them is modified, so that
+  // taking a snapshot for export does not copy every row.
   union {
-    DataMap<double> double_data_;
-    DataMap<int64_t> int_data_;
-    DataMap<Distribution> distribution_data_;
-    DataMap<IntervalStatsObject> interval_data_;
+    std::shared_ptr<DataMap<double>> double_data_;
+    std::shared_ptr<DataMap<int64_t>> int_data_;
+    std::shared_ptr<DataMap<Distribution>> distribution_data_;
+    std::shared_ptr<DataMap<IntervalRow>> interval_data_;
   };
   absl::Time start_time_;
   absl::Time end_time_;
+  uint64_t generation_ = 0;
+  // A linear counting sketch (Whang et al., 1990) of the tag values redirected
+  // to the overflow row: the bit for the hash of each is set. Null until the
+  // first redirection, so that only overflowing views pay for it, and shared
+  // between copies like the data, so that snapshots do not copy it.
+  std::shared_ptr<std::vector<uint64_t>> dropped_tagset_bits_;
+  int dropped_tagset_bits_set_ = 0;
+  int64_t dropped_records_ = 0;
+  // The overflow row as last returned by FindOrAddRow() for tag values
+  // without a row, valid while generation_ is overflow_row_generation_.
+  Row overflow_row_ = nullptr;
+  uint64_t overflow_row_generation_ = 0;
+
+  const absl::Duration row_ttl_;
+  // The times of each row, shared along with the data; null unless this is a
+  // cumulative view with a row TTL.
+  std::shared_ptr<DataMap<RowTimes>> row_times_;
+  // When ExpireRows() next looks for expired rows.
+  absl::Time next_expiry_check_;
+  // When rows last expired, or start_time_ if none have.
+  absl::Time last_expiry_;
 };
 
 }  // namespace stats
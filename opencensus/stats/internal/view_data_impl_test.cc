@@ -15,7 +15,9 @@
 #include "opencensus/stats/internal/view_data_impl.h"
 
 #include <limits>
+#include <memory>
 
+#include "absl/memory/memory.h"
 #include "absl/time/time.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -83,6 +85,170 @@ TEST(ViewDataImplTest, Count) {
                                               ::testing::Pair(tags2, 1)));
 }
 
+TEST(ViewDataImplTest, MergeRow) {
+  const absl::Time start_time = absl::UnixEpoch();
+  const absl::Time end_time = absl::UnixEpoch() + absl::Seconds(1);
+  auto descriptor = ViewDescriptor().set_aggregation(Aggregation::Sum());
+  SetAggregationWindow(AggregationWindow::Delta(), &descriptor);
+  ViewDataImpl data(start_time, descriptor);
+  const std::vector<std::string> tags({"value1", "value2"});
+  MeasureData measure_data = MeasureData({});
+  measure_data.Add(2);
+
+  const ViewDataImpl::Row row = data.FindOrAddRow(tags, start_time);
+  EXPECT_EQ(row, data.FindOrAddRow(tags, start_time));
+  data.MergeRow(row, measure_data, start_time);
+  data.MergeRow(row, measure_data, end_time);
+  EXPECT_EQ(end_time, data.end_time());
+  EXPECT_THAT(data.double_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(tags, 4)));
+
+  const uint64_t generation = data.generation();
+  data.GetDeltaAndReset(end_time);
+  EXPECT_NE(generation, data.generation());
+  EXPECT_TRUE(data.double_data().empty());
+}
+
+TEST(ViewDataImplTest, CopySharesDataUntilModified) {
+  const absl::Time time = absl::UnixEpoch();
+  const auto descriptor = ViewDescriptor().set_aggregation(Aggregation::Sum());
+  ViewDataImpl data(time, descriptor);
+  const std::vector<std::string> tags1({"value1"});
+  const std::vector<std::string> tags2({"value2"});
+  AddToViewDataImpl(1, tags1, time, {}, &data);
+
+  const ViewDataImpl copy(data);
+  EXPECT_EQ(&data.double_data(), &copy.double_data());
+
+  const uint64_t generation = data.generation();
+  AddToViewDataImpl(2, tags1, time, {}, &data);
+  AddToViewDataImpl(3, tags2, time, {}, &data);
+  EXPECT_NE(generation, data.generation());
+  EXPECT_THAT(copy.double_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(tags1, 1)));
+  EXPECT_THAT(data.double_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(tags1, 3),
+                                              ::testing::Pair(tags2, 3)));
+}
+
+TEST(ViewDataImplTest, MaxRows) {
+  const absl::Time time = absl::UnixEpoch();
+  auto descriptor =
+      ViewDescriptor().set_aggregation(Aggregation::Sum()).set_max_rows(3);
+  SetAggregationWindow(AggregationWindow::Delta(), &descriptor);
+  ViewDataImpl data(time, descriptor);
+  const std::vector<std::string> tags1({"value1", "value1"});
+  const std::vector<std::string> tags2({"value2", "value2"});
+  const std::vector<std::string> overflow_tags(
+      {ViewDescriptor::kOverflowTagValue, ViewDescriptor::kOverflowTagValue});
+  AddToViewDataImpl(1, tags1, time, {}, &data);
+  AddToViewDataImpl(2, tags2, time, {}, &data);
+  AddToViewDataImpl(3, {"value3", "value3"}, time, {}, &data);
+  AddToViewDataImpl(4, {"value4", "value4"}, time, {}, &data);
+  // Existing rows are still updated once the limit is reached, and dropped
+  // tag values are counted once.
+  AddToViewDataImpl(5, tags1, time, {}, &data);
+  AddToViewDataImpl(6, {"value3", "value3"}, time, {}, &data);
+  EXPECT_EQ(3, data.num_rows());
+  EXPECT_THAT(data.double_data(),
+              ::testing::UnorderedElementsAre(
+                  ::testing::Pair(tags1, 6), ::testing::Pair(tags2, 2),
+                  ::testing::Pair(overflow_tags, 13)));
+  EXPECT_EQ(2, data.dropped_tagsets());
+  EXPECT_EQ(3, data.dropped_records());
+
+  // Snapshots share the sketch until the view drops more tag values.
+  const ViewDataImpl snapshot(data);
+  AddToViewDataImpl(7, {"value5", "value5"}, time, {}, &data);
+  EXPECT_EQ(2, snapshot.dropped_tagsets());
+  EXPECT_EQ(3, snapshot.dropped_records());
+  EXPECT_EQ(3, data.dropped_tagsets());
+  EXPECT_EQ(4, data.dropped_records());
+
+  const auto delta = data.GetDeltaAndReset(time);
+  EXPECT_EQ(3, delta->dropped_tagsets());
+  EXPECT_EQ(4, delta->dropped_records());
+  EXPECT_EQ(0, data.dropped_tagsets());
+  EXPECT_EQ(0, data.dropped_records());
+}
+
+TEST(ViewDataImplTest, DroppedTagsetsEstimate) {
+  const absl::Time time = absl::UnixEpoch();
+  auto descriptor =
+      ViewDescriptor().set_aggregation(Aggregation::Sum()).set_max_rows(1);
+  SetAggregationWindow(AggregationWindow::Delta(), &descriptor);
+  ViewDataImpl data(time, descriptor);
+  for (int repeat = 0; repeat < 2; ++repeat) {
+    for (int i = 0; i < 10000; ++i) {
+      AddToViewDataImpl(1, {"value" + std::to_string(i)}, time, {}, &data);
+    }
+  }
+  EXPECT_EQ(1, data.num_rows());
+  EXPECT_NEAR(10000, data.dropped_tagsets(), 300);
+}
+
+TEST(ViewDataImplTest, RowTtl) {
+  const absl::Time start_time = absl::UnixEpoch();
+  const auto descriptor = ViewDescriptor()
+                              .set_aggregation(Aggregation::Sum())
+                              .set_row_ttl(absl::Seconds(4));
+  ViewDataImpl data(start_time, descriptor);
+  const std::vector<std::string> tags1({"value1"});
+  const std::vector<std::string> tags2({"value2"});
+  AddToViewDataImpl(1, tags1, start_time, {}, &data);
+  AddToViewDataImpl(2, tags2, start_time, {}, &data);
+  const ViewDataImpl snapshot(data);
+
+  // Only tags1 is updated within the TTL.
+  const absl::Time update_time = start_time + absl::Seconds(3);
+  AddToViewDataImpl(1, tags1, update_time, {}, &data);
+  const absl::Time expiry_time = start_time + absl::Seconds(5);
+  const uint64_t generation = data.generation();
+  data.ExpireRows(expiry_time);
+  EXPECT_NE(generation, data.generation());
+  EXPECT_THAT(data.double_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(tags1, 2)));
+  EXPECT_EQ(2, snapshot.double_data().size());
+
+  // An expired row restarts from zero.
+  AddToViewDataImpl(3, tags2, expiry_time, {}, &data);
+  EXPECT_THAT(data.double_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(tags1, 2),
+                                              ::testing::Pair(tags2, 3)));
+  EXPECT_EQ(start_time, data.row_start_time(tags1));
+  EXPECT_EQ(expiry_time, data.row_start_time(tags2));
+  EXPECT_EQ(start_time, snapshot.row_start_time(tags2));
+}
+
+TEST(ViewDataImplTest, RowTtlDroppedSnapshot) {
+  const absl::Time start_time = absl::UnixEpoch();
+  const auto descriptor = ViewDescriptor()
+                              .set_aggregation(Aggregation::Sum())
+                              .set_row_ttl(absl::Seconds(4));
+  ViewDataImpl data(start_time, descriptor);
+  const std::vector<std::string> tags1({"value1"});
+  const std::vector<std::string> tags2({"value2"});
+  AddToViewDataImpl(1, tags1, start_time, {}, &data);
+  auto snapshot = absl::make_unique<ViewDataImpl>(data);
+  snapshot.reset();
+
+  // The rows remain valid once the data is no longer shared.
+  AddToViewDataImpl(2, tags1, start_time, {}, &data);
+  AddToViewDataImpl(3, tags2, start_time + absl::Seconds(3), {}, &data);
+  data.ExpireRows(start_time + absl::Seconds(5));
+  AddToViewDataImpl(4, tags2, start_time + absl::Seconds(5), {}, &data);
+  EXPECT_THAT(data.double_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(tags2, 7)));
+
+  // And after copying while shared.
+  snapshot = absl::make_unique<ViewDataImpl>(data);
+  AddToViewDataImpl(5, tags2, start_time + absl::Seconds(6), {}, &data);
+  snapshot.reset();
+  AddToViewDataImpl(6, tags2, start_time + absl::Seconds(6), {}, &data);
+  EXPECT_THAT(data.double_data(),
+              ::testing::UnorderedElementsAre(::testing::Pair(tags2, 18)));
+}
+
 TEST(ViewDataImplTest, Distribution) {
   const absl::Time start_time = absl::UnixEpoch();
   const absl::Time end_time = absl::UnixEpoch() + absl::Seconds(1);
@@ -108,6 +274,49 @@ TEST(ViewDataImplTest, Distribution) {
               ::testing::ElementsAre(0, 1));
 }
 
+TEST(ViewDataImplTest, LogLinearHistogram) {
+  const absl::Time time = absl::UnixEpoch();
+  const Aggregation aggregation = Aggregation::LogLinearHistogram(2);
+  const BucketBoundaries& buckets = aggregation.bucket_boundaries();
+  const auto descriptor = ViewDescriptor().set_aggregation(aggregation);
+  ViewDataImpl data(time, descriptor);
+  const std::vector<std::string> tags({"value"});
+
+  AddToViewDataImpl(1, tags, time, {buckets}, &data);
+  AddToViewDataImpl(1.6, tags, time, {buckets}, &data);
+  const Distribution& distribution =
+      data.distribution_data().find(tags)->second;
+  EXPECT_EQ(buckets.BucketForValue(1), distribution.bucket_offset());
+  EXPECT_THAT(distribution.bucket_counts(), ::testing::ElementsAre(1, 0, 1));
+}
+
+TEST(ViewDataImplTest, QuantileSketch) {
+  const absl::Time time = absl::UnixEpoch();
+  const Aggregation aggregation = Aggregation::QuantileSketch(2, 3);
+  const BucketBoundaries& buckets = aggregation.bucket_boundaries();
+  const auto descriptor = ViewDescriptor().set_aggregation(aggregation);
+  ViewDataImpl data(time, descriptor);
+  const std::vector<std::string> tags({"value"});
+
+  // Buckets of 2^0 start at 1, 1.25, 1.5 and 1.75.
+  for (const double value : {1.0, 1.3, 1.6, 1.8, 1.9}) {
+    AddToViewDataImpl(value, tags, time, {buckets}, &data);
+  }
+  // The lowest two buckets are collapsed into one.
+  const Distribution& distribution =
+      data.distribution_data().find(tags)->second;
+  EXPECT_EQ(buckets.BucketForValue(1.3), distribution.bucket_offset());
+  EXPECT_THAT(distribution.bucket_counts(), ::testing::ElementsAre(2, 1, 2));
+  EXPECT_NEAR(1.8, distribution.Quantile(0.9), 1.8 / 8);
+
+  AddToViewDataImpl(0.9, tags, time, {buckets}, &data);
+  EXPECT_EQ(buckets.BucketForValue(1.3), distribution.bucket_offset());
+  EXPECT_THAT(distribution.bucket_counts(), ::testing::ElementsAre(3, 1, 2));
+  // Quantiles in the collapsed bucket extend down to the minimum.
+  EXPECT_GE(distribution.Quantile(0.2), 0.9);
+  EXPECT_LT(distribution.Quantile(0.2), 1.25);
+}
+
 TEST(ViewDataImplTest, LastValueDouble) {
   const absl::Time start_time = absl::UnixEpoch();
   const absl::Time end_time = absl::UnixEpoch() + absl::Seconds(1);
@@ -228,6 +437,89 @@ TEST(ViewDataImplTest, StatsObjectToSum) {
                                               ::testing::Pair(tags2, 0)));
 }
 
+TEST(ViewDataImplTest, StatsObjectToLogLinearHistogram) {
+  const absl::Duration interval = absl::Minutes(1);
+  absl::Time time = absl::UnixEpoch();
+  const Aggregation aggregation = Aggregation::LogLinearHistogram(2);
+  const BucketBoundaries& buckets = aggregation.bucket_boundaries();
+  auto descriptor = ViewDescriptor().set_aggregation(aggregation);
+  SetAggregationWindow(AggregationWindow::Interval(interval), &descriptor);
+  ViewDataImpl data(time, descriptor);
+  const std::vector<std::string> tags({"value"});
+
+  AddToViewDataImpl(3, tags, time, {buckets}, &data);
+  AddToViewDataImpl(2, tags, time, {buckets}, &data);
+  AddToViewDataImpl(3.2, tags, time, {buckets}, &data);
+  // The windows hold only the populated range, after the 5 statistics.
+  EXPECT_EQ(5 + 3, data.interval_data().find(tags)->second.stats.num_stats());
+
+  // The exported distribution holds only the populated range.
+  const ViewDataImpl export_data1(data, time);
+  const Distribution& distribution1 =
+      export_data1.distribution_data().find(tags)->second;
+  EXPECT_EQ(3, distribution1.count());
+  EXPECT_EQ(buckets.BucketForValue(2), distribution1.bucket_offset());
+  EXPECT_THAT(distribution1.bucket_counts(), ::testing::ElementsAre(1, 0, 2));
+
+  // The windows grow in both directions as needed.
+  time += interval / 2;
+  AddToViewDataImpl(1.5, tags, time, {buckets}, &data);
+  AddToViewDataImpl(5, tags, time, {buckets}, &data);
+  const ViewDataImpl export_data2(data, time);
+  const Distribution& distribution2 =
+      export_data2.distribution_data().find(tags)->second;
+  EXPECT_EQ(5, distribution2.count());
+  EXPECT_EQ(buckets.BucketForValue(1.5), distribution2.bucket_offset());
+  EXPECT_EQ(buckets.BucketForValue(5) - buckets.BucketForValue(1.5) + 1,
+            distribution2.bucket_counts().size());
+
+  // Once the first values expire, the export is trimmed to the rest.
+  time += interval;
+  const ViewDataImpl export_data3(data, time);
+  const Distribution& distribution3 =
+      export_data3.distribution_data().find(tags)->second;
+  EXPECT_EQ(2, distribution3.count());
+  EXPECT_EQ(buckets.BucketForValue(1.5), distribution3.bucket_offset());
+  EXPECT_EQ(1, distribution3.bucket_counts().front());
+  EXPECT_EQ(1, distribution3.bucket_counts().back());
+}
+
+TEST(ViewDataImplTest, StatsObjectToQuantileSketch) {
+  const absl::Duration interval = absl::Minutes(1);
+  absl::Time time = absl::UnixEpoch();
+  const Aggregation aggregation = Aggregation::QuantileSketch(2, 4);
+  const BucketBoundaries& buckets = aggregation.bucket_boundaries();
+  auto descriptor = ViewDescriptor().set_aggregation(aggregation);
+  SetAggregationWindow(AggregationWindow::Interval(interval), &descriptor);
+  ViewDataImpl data(time, descriptor);
+  const std::vector<std::string> tags({"value"});
+
+  for (int i = 1; i <= 10; ++i) {
+    AddToViewDataImpl(i, tags, time, {buckets}, &data);
+  }
+  // Each window holds at most 4 buckets, the lowest collapsed into the first.
+  EXPECT_EQ(5 + 4, data.interval_data().find(tags)->second.stats.num_stats());
+  const ViewDataImpl export_data1(data, time);
+  const Distribution& distribution1 =
+      export_data1.distribution_data().find(tags)->second;
+  EXPECT_EQ(10, distribution1.count());
+  EXPECT_EQ(1, distribution1.min());
+  EXPECT_EQ(buckets.BucketForValue(10) - 3, distribution1.bucket_offset());
+  EXPECT_EQ(4, distribution1.bucket_counts().size());
+  EXPECT_EQ(1, distribution1.bucket_counts().back());
+
+  // Once the first window expires, the rest are exported alone.
+  time += interval / 2;
+  AddToViewDataImpl(100, tags, time, {buckets}, &data);
+  time += interval;
+  const ViewDataImpl export_data2(data, time);
+  const Distribution& distribution2 =
+      export_data2.distribution_data().find(tags)->second;
+  EXPECT_EQ(1, distribution2.count());
+  EXPECT_EQ(buckets.BucketForValue(100), distribution2.bucket_offset());
+  EXPECT_THAT(distribution2.bucket_counts(), ::testing::ElementsAre(1));
+}
+
 TEST(ViewDataImplTest, StatsObjectToDistribution) {
   const absl::Duration interval = absl::Minutes(1);
   const absl::Time start_time = absl::UnixEpoch();
@@ -39,6 +39,8 @@ namespace stats {
 // TODO: FIXME: Distinguish never-set values, and add an IsValid()
 // method checking required fields.
 
+constexpr char ViewDescriptor::kOverflowTagValue[];
+
 ViewDescriptor::ViewDescriptor()
     : aggregation_(Aggregation::Sum()),
       aggregation_window_(AggregationWindow::Cumulative()) {}
@@ -69,6 +71,20 @@ ViewDescriptor& ViewDescriptor::add_column(opencensus::tags::TagKey tag_key) {
   return *this;
 }
 
+ViewDescriptor& ViewDescriptor::set_max_rows(size_t max_rows) {
+  max_rows_ = max_rows;
+  return *this;
+}
+
+ViewDescriptor& ViewDescriptor::set_row_ttl(absl::Duration ttl) {
+  if (ttl <= absl::ZeroDuration()) {
+    std::cerr << "Row TTL must be positive.\n";
+    return *this;
+  }
+  row_ttl_ = ttl;
+  return *this;
+}
+
 ViewDescriptor& ViewDescriptor::set_description(absl::string_view description) {
   description_ = std::string(description);
   return *this;
@@ -93,6 +109,8 @@ std::string ViewDescriptor::DebugString() const {
                     [](std::string* out, opencensus::tags::TagKey key) {
                       return out->append(key.name());
                     }),
+      "\n  max rows: ", max_rows_,
+      "\n  row TTL: ", absl::FormatDuration(row_ttl_),
       "\n  description: \"", description_, "\"");
 }
 
@@ -100,7 +118,8 @@ bool ViewDescriptor::operator==(const ViewDescriptor& other) const {
   return name_ == other.name_ && measure_id_ == other.measure_id_ &&
          aggregation_ == other.aggregation_ &&
          aggregation_window_ == other.aggregation_window_ &&
-         columns_ == other.columns_ && description_ == other.description_;
+         columns_ == other.columns_ && max_rows_ == other.max_rows_ &&
+         row_ttl_ == other.row_ttl_ && description_ == other.description_;
 }
 
 }  // namespace stats
@@ -0,0 +1,96 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "opencensus/stats/internal/worker_pool.h"
+
+#include <functional>
+#include <thread>
+
+#include "absl/synchronization/mutex.h"
+
+namespace opencensus {
+namespace stats {
+
+WorkerPool::WorkerPool(int num_threads) {
+  threads_.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&WorkerPool::WorkerLoop, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    absl::MutexLock l(&mu_);
+    shutdown_ = true;
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::ParallelFor(int num_tasks,
+                             const std::function<void(int)>& task) {
+  absl::MutexLock batch_lock(&batch_mu_);
+  {
+    absl::MutexLock l(&mu_);
+    task_ = &task;
+    num_tasks_ = num_tasks;
+    next_task_ = 0;
+    pending_tasks_ = num_tasks;
+  }
+  RunTasks();
+  absl::MutexLock l(&mu_);
+  mu_.Await(absl::Condition(
+      +[](int* pending_tasks) { return *pending_tasks == 0; },
+      &pending_tasks_));
+  task_ = nullptr;
+}
+
+void WorkerPool::RunTasks() {
+  while (true) {
+    const std::function<void(int)>* task;
+    int index;
+    {
+      absl::MutexLock l(&mu_);
+      if (task_ == nullptr || next_task_ == num_tasks_) {
+        return;
+      }
+      task = task_;
+      index = next_task_++;
+    }
+    (*task)(index);
+    absl::MutexLock l(&mu_);
+    --pending_tasks_;
+  }
+}
+
+void WorkerPool::WorkerLoop() {
+  while (true) {
+    {
+      absl::MutexLock l(&mu_);
+      mu_.Await(absl::Condition(this, &WorkerPool::HasWorkOrShutdown));
+      if (shutdown_) {
+        return;
+      }
+    }
+    RunTasks();
+  }
+}
+
+bool WorkerPool::HasWorkOrShutdown() const {
+  return shutdown_ || (task_ != nullptr && next_task_ < num_tasks_);
+}
+
+}  // namespace stats
+}  // namespace opencensus
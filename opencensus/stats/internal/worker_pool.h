@@ -0,0 +1,75 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OPENCENSUS_STATS_INTERNAL_WORKER_POOL_H_
+#define OPENCENSUS_STATS_INTERNAL_WORKER_POOL_H_
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace opencensus {
+namespace stats {
+
+// WorkerPool runs batches of independent tasks on a fixed set of threads.
+//
+// WorkerPool is thread-safe; concurrent batches run one after another.
+class WorkerPool final {
+ public:
+  // Starts 'num_threads' worker threads.
+  explicit WorkerPool(int num_threads);
+  // Stops and joins the worker threads.
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  int num_threads() const { return threads_.size(); }
+
+  // Calls task(i) for each i in [0, num_tasks), on the worker threads and the
+  // calling thread, and returns once all calls have returned. Tasks are handed
+  // out one at a time, so uneven tasks balance across threads.
+  void ParallelFor(int num_tasks, const std::function<void(int)>& task)
+      LOCKS_EXCLUDED(batch_mu_, mu_);
+
+ private:
+  // Runs tasks from the current batch until none are left to claim.
+  void RunTasks() LOCKS_EXCLUDED(mu_);
+  void WorkerLoop() LOCKS_EXCLUDED(mu_);
+
+  bool HasWorkOrShutdown() const EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Serializes calls to ParallelFor().
+  absl::Mutex batch_mu_;
+
+  // Guards the current batch.
+  mutable absl::Mutex mu_ ACQUIRED_AFTER(batch_mu_);
+  // The task of the current batch, or null between batches.
+  const std::function<void(int)>* task_ GUARDED_BY(mu_) = nullptr;
+  int num_tasks_ GUARDED_BY(mu_) = 0;
+  // The next task to hand out.
+  int next_task_ GUARDED_BY(mu_) = 0;
+  // The number of tasks of the current batch that have not returned.
+  int pending_tasks_ GUARDED_BY(mu_) = 0;
+  bool shutdown_ GUARDED_BY(mu_) = false;
+
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace stats
+}  // namespace opencensus
+
+#endif  // OPENCENSUS_STATS_INTERNAL_WORKER_POOL_H_
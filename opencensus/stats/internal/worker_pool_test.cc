@@ -0,0 +1,78 @@
+// Copyright 2018, OpenCensus Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "opencensus/stats/internal/worker_pool.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "gtest/gtest.h"
+
+namespace opencensus {
+namespace stats {
+namespace {
+
+TEST(WorkerPoolTest, RunsEachTaskOnce) {
+  WorkerPool pool(3);
+  EXPECT_EQ(3, pool.num_threads());
+  const int kNumTasks = 100;
+  std::vector<std::atomic<int>> calls(kNumTasks);
+  for (int batch = 0; batch < 10; ++batch) {
+    pool.ParallelFor(kNumTasks, [&calls](int i) { ++calls[i]; });
+    for (int i = 0; i < kNumTasks; ++i) {
+      ASSERT_EQ(batch + 1, calls[i].load());
+    }
+  }
+}
+
+TEST(WorkerPoolTest, RunsTasksInParallel) {
+  WorkerPool pool(1);
+  // Each task waits for the other, so the batch only completes if both run at
+  // once.
+  absl::Mutex mu;
+  int started = 0;
+  pool.ParallelFor(2, [&mu, &started](int) {
+    absl::MutexLock l(&mu);
+    ++started;
+    mu.Await(absl::Condition(
+        +[](int* started) { return *started == 2; }, &started));
+  });
+  EXPECT_EQ(2, started);
+}
+
+TEST(WorkerPoolTest, EmptyBatch) {
+  WorkerPool pool(2);
+  pool.ParallelFor(0, [](int) { FAIL(); });
+}
+
+TEST(WorkerPoolTest, ConcurrentBatches) {
+  WorkerPool pool(2);
+  std::atomic<int> calls(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&pool, &calls]() {
+      pool.ParallelFor(10, [&calls](int) { ++calls; });
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(40, calls.load());
+}
+
+}  // namespace
+}  // namespace stats
+}  // namespace opencensus
@@ -16,13 +16,20 @@
 #define OPENCENSUS_STATS_MEASURE_H_
 
 #include <cstdint>
+#include <memory>
 #include <type_traits>
+#include <utility>
 
 #include "opencensus/stats/measure_descriptor.h"
+#include "opencensus/tags/tag_map.h"
 
 namespace opencensus {
 namespace stats {
 
+class BoundMeasureCell;
+template <typename MeasureT>
+class BoundMeasure;
+
 // A Measure represents a certain type of record, such as the latency of a
 // request. Value events are recorded against measures, and a view specifying
 // that measure can retrieve the data for those events. Measures can only be
@@ -69,6 +76,10 @@ class Measure final {
   // invalid Measure logs an error and assert-fails in debug mode.
   bool IsValid() const;
 
+  // Returns a handle for recording values against this measure under 'tags'.
+  // See BoundMeasure below.
+  BoundMeasure<MeasureT> Bind(opencensus::tags::TagMap tags) const;
+
   Measure(const Measure<MeasureT>& other) : id_(other.id_) {}
   bool operator==(Measure<MeasureT> other) const { return id_ == other.id_; }
 
@@ -83,6 +94,34 @@ class Measure final {
 typedef Measure<double> MeasureDouble;
 typedef Measure<int64_t> MeasureInt64;
 
+// BoundMeasure is a Measure bound to a fixed set of tags, obtained from
+// Measure::Bind(). Recording through a BoundMeasure is equivalent to
+//   Record({{measure, value}}, tags);
+// but aggregates directly into storage owned by the handle, skipping the
+// per-call hashing and lookup of 'tags'. It is intended for hot paths that
+// repeatedly record the same measure under the same tags; handles should be
+// created once and reused.
+//
+// BoundMeasure is thread-safe. Copies share the same storage.
+template <typename MeasureT>
+class BoundMeasure final {
+ public:
+  // Records 'value'. Recording through a handle bound to an invalid measure
+  // does nothing.
+  void Record(MeasureT value) const;
+
+ private:
+  friend class Measure<MeasureT>;
+  explicit BoundMeasure(std::shared_ptr<BoundMeasureCell> cell)
+      : cell_(std::move(cell)) {}
+
+  // Null if the measure is invalid.
+  std::shared_ptr<BoundMeasureCell> cell_;
+};
+
+typedef BoundMeasure<double> BoundMeasureDouble;
+typedef BoundMeasure<int64_t> BoundMeasureInt64;
+
 // Measurement is an immutable pair of a Measure and corresponding value to
 // record--refer to comments in recording.h for further information.
 // TODO: Write a non-compilation test.
@@ -115,6 +154,8 @@ template <>
 bool MeasureInt64::IsValid() const;
 extern template class Measure<double>;
 extern template class Measure<int64_t>;
+extern template class BoundMeasure<double>;
+extern template class BoundMeasure<int64_t>;
 
 }  // namespace stats
 }  // namespace opencensus
@@ -15,8 +15,10 @@
 #ifndef OPENCENSUS_STATS_RECORDING_H_
 #define OPENCENSUS_STATS_RECORDING_H_
 
+#include <cstdint>
 #include <initializer_list>
 
+#include "absl/types/span.h"
 #include "opencensus/stats/measure.h"
 #include "opencensus/tags/tag_map.h"
 
@@ -41,6 +43,20 @@ void Record(std::initializer_list<Measurement> measurements);
 void Record(std::initializer_list<Measurement> measurements,
             opencensus::tags::TagMap tags);
 
+// Records each of 'values' against 'measure' under the current Context's
+// tags. This is equivalent to calling Record() once per value, but aggregates
+// the whole batch at once, which is much faster for large batches. Recording
+// against an invalid measure does nothing.
+void RecordBatch(MeasureDouble measure, absl::Span<const double> values);
+void RecordBatch(MeasureInt64 measure, absl::Span<const int64_t> values);
+
+// Records each of 'values' against 'measure' under the specified 'tags', as
+// above.
+void RecordBatch(MeasureDouble measure, absl::Span<const double> values,
+                 opencensus::tags::TagMap tags);
+void RecordBatch(MeasureInt64 measure, absl::Span<const int64_t> values,
+                 opencensus::tags::TagMap tags);
+
 }  // namespace stats
 }  // namespace opencensus
 
@@ -15,6 +15,10 @@
 #ifndef OPENCENSUS_STATS_VIEW_H_
 #define OPENCENSUS_STATS_VIEW_H_
 
+#include <functional>
+#include <string>
+#include <vector>
+
 #include "opencensus/stats/internal/stats_manager.h"
 #include "opencensus/stats/view_data.h"
 #include "opencensus/stats/view_descriptor.h"
@@ -48,7 +52,15 @@ class View {
   // Returns a snapshot of the View's data.
   const ViewData GetData();
 
-  // TODO: Consider a means of querying one tagset to avoid copying.
+  // Returns a snapshot of the row for 'tag_values' (the values of
+  // descriptor().columns(), in order), or an empty ViewData if there is no
+  // such row. Only that row is copied, and data recorded before the call is
+  // included. Unlike GetData(), this does not reset Delta-window data.
+  const ViewData GetRow(const std::vector<std::string>& tag_values);
+
+  // Like GetRow(), but returns the rows whose tag values satisfy 'filter'.
+  const ViewData GetRows(
+      const std::function<bool(const std::vector<std::string>&)>& filter);
 
   const ViewDescriptor& descriptor() { return descriptor_; }
 
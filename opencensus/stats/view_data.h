@@ -68,6 +68,18 @@ class ViewData {
 
   absl::Time start_time() const;
   absl::Time end_time() const;
+  // The start time of the data for 'tag_values'. This is later than
+  // start_time() for rows that restarted after expiring (see
+  // ViewDescriptor::set_row_ttl()).
+  absl::Time row_start_time(const std::vector<std::string>& tag_values) const;
+
+  // An estimate of the number of distinct tag values whose data was merged
+  // into the overflow row because the view had ViewDescriptor::max_rows()
+  // rows. Counts up to a few hundred are exact with high probability.
+  int64_t dropped_tagsets() const;
+  // The exact number of measurements for those tag values that were merged
+  // into the overflow row.
+  int64_t dropped_records() const;
 
   ViewData(const ViewData& other);
 
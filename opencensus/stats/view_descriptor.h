@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "opencensus/stats/aggregation.h"
 #include "opencensus/stats/internal/aggregation_window.h"
 #include "opencensus/stats/measure_descriptor.h"
@@ -75,6 +76,26 @@ class ViewDescriptor final {
     return columns_;
   }
 
+  // Limits the number of rows the view keeps, bounding its memory when a
+  // column takes unexpectedly many values. One of the 'max_rows' rows is
+  // reserved for an overflow row whose tag values are all kOverflowTagValue:
+  // once the other rows are taken, data for other tag values is merged into
+  // it, and the tag values are counted in ViewData::dropped_tagsets() and
+  // their measurements in ViewData::dropped_records(). The default, 0, means no
+  // limit.
+  ViewDescriptor& set_max_rows(size_t max_rows);
+  size_t max_rows() const { return max_rows_; }
+  static constexpr char kOverflowTagValue[] = "opencensus_overflow";
+
+  // Sets how long rows of a cumulative view are kept without being updated.
+  // Expired rows are dropped from the view's data; if their tag values are
+  // recorded again, the row restarts from zero with a new
+  // ViewData::row_start_time(). Rows are checked for expiry every 'ttl' / 4.
+  // The default, absl::InfiniteDuration(), keeps rows forever. Has no effect
+  // on other aggregation windows.
+  ViewDescriptor& set_row_ttl(absl::Duration ttl);
+  absl::Duration row_ttl() const { return row_ttl_; }
+
   // Sets a human-readable description for the view.
   ViewDescriptor& set_description(absl::string_view description);
   const std::string& description() const { return description_; }
@@ -109,6 +130,8 @@ class ViewDescriptor final {
   Aggregation aggregation_;
   AggregationWindow aggregation_window_;
   std::vector<opencensus::tags::TagKey> columns_;
+  size_t max_rows_ = 0;
+  absl::Duration row_ttl_ = absl::InfiniteDuration();
   std::string description_;
 };
 
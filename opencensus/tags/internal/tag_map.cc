@@ -15,70 +15,173 @@
 #include "opencensus/tags/tag_map.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <initializer_list>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "opencensus/common/internal/hash_mix.h"
 #include "opencensus/tags/tag_key.h"
 
 namespace opencensus {
 namespace tags {
 
+// TagMapInternTable holds a weak reference to the representation of each
+// interned TagMap. Each interned representation removes itself from the table
+// when it is destroyed.
+class TagMapInternTable {
+ public:
+  static TagMapInternTable* Get() {
+    static TagMapInternTable* global_tag_map_intern_table =
+        new TagMapInternTable;
+    return global_tag_map_intern_table;
+  }
+
+  TagMap Intern(const TagMap::Rep& rep) LOCKS_EXCLUDED(mu_);
+
+ private:
+  // Deletes an interned representation, removing it from the table.
+  static void Delete(const TagMap::Rep* rep);
+
+  absl::Mutex mu_;
+  // Interned representations by hash. Expired entries are removed by the
+  // deleter of their representation.
+  std::unordered_multimap<std::size_t, std::weak_ptr<const TagMap::Rep>> reps_
+      GUARDED_BY(mu_);
+  std::atomic<uint64_t> next_id_{1};
+};
+
+TagMap TagMapInternTable::Intern(const TagMap::Rep& rep) {
+  // Releasing the last reference to an interned representation acquires mu_
+  // to remove it, so references taken while searching must outlive the lock.
+  std::vector<std::shared_ptr<const TagMap::Rep>> collisions;
+  absl::MutexLock l(&mu_);
+  const auto range = reps_.equal_range(rep.hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    std::shared_ptr<const TagMap::Rep> interned = it->second.lock();
+    // An expired entry may linger until its deleter runs; a new
+    // representation is interned in its place.
+    if (interned != nullptr) {
+      if (interned->tags == rep.tags) {
+        return TagMap(std::move(interned));
+      }
+      collisions.push_back(std::move(interned));
+    }
+  }
+  std::shared_ptr<const TagMap::Rep> interned(
+      new TagMap::Rep{rep.hash,
+                      next_id_.fetch_add(1, std::memory_order_relaxed),
+                      rep.tags},
+      &TagMapInternTable::Delete);
+  reps_.emplace(rep.hash, interned);
+  return TagMap(std::move(interned));
+}
+
+// static
+void TagMapInternTable::Delete(const TagMap::Rep* rep) {
+  TagMapInternTable* table = Get();
+  {
+    absl::MutexLock l(&table->mu_);
+    const auto range = table->reps_.equal_range(rep->hash);
+    for (auto it = range.first; it != range.second;) {
+      if (it->second.expired()) {
+        it = table->reps_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  delete rep;
+}
+
 TagMap::TagMap(
     std::initializer_list<std::pair<TagKey, absl::string_view>> tags) {
-  tags_.reserve(tags.size());
+  std::vector<std::pair<TagKey, std::string>> tags_vector;
+  tags_vector.reserve(tags.size());
   for (const auto& tag : tags) {
-    tags_.emplace_back(tag.first, std::string(tag.second));
+    tags_vector.emplace_back(tag.first, std::string(tag.second));
   }
-  Initialize();
+  rep_ = MakeRep(std::move(tags_vector));
 }
 
 TagMap::TagMap(std::vector<std::pair<TagKey, std::string>> tags)
-    : tags_(std::move(tags)) {
-  Initialize();
+    : rep_(MakeRep(std::move(tags))) {}
+
+// static
+const std::vector<std::pair<TagKey, std::string>>& TagMap::EmptyTags() {
+  static const auto* const empty_tags =
+      new std::vector<std::pair<TagKey, std::string>>;
+  return *empty_tags;
 }
 
-void TagMap::Initialize() {
-  std::sort(tags_.begin(), tags_.end());
+// static
+std::shared_ptr<const TagMap::Rep> TagMap::MakeRep(
+    std::vector<std::pair<TagKey, std::string>> tags) {
+  if (tags.empty()) {
+    return nullptr;
+  }
+  std::sort(tags.begin(), tags.end());
 
 #ifndef NDEBUG
   auto compare_keys = [](const std::pair<TagKey, std::string>& a,
                          const std::pair<TagKey, std::string>& b) {
     return a.first == b.first;
   };
-  assert(std::adjacent_find(tags_.begin(), tags_.end(), compare_keys) ==
-             tags_.end() &&
+  assert(std::adjacent_find(tags.begin(), tags.end(), compare_keys) ==
+             tags.end() &&
          "Duplicate keys are not allowed in TagMap.");
 #endif
 
   std::hash<std::string> hasher;
   common::HashMix mixer;
-  for (const auto& tag : tags_) {
+  for (const auto& tag : tags) {
     mixer.Mix(tag.first.hash());
     mixer.Mix(hasher(tag.second));
   }
-  hash_ = mixer.get();
+  return std::make_shared<const Rep>(Rep{mixer.get(), 0, std::move(tags)});
+}
+
+TagMap TagMap::Intern() const {
+  if (rep_ == nullptr || rep_->id != 0) {
+    return *this;
+  }
+  return TagMapInternTable::Get()->Intern(*rep_);
 }
 
 std::size_t TagMap::Hash::operator()(const TagMap& tags) const {
-  return tags.hash_;
+  return tags.rep_ != nullptr ? tags.rep_->hash : 0;
 }
 
 bool TagMap::operator==(const TagMap& other) const {
-  return tags_ == other.tags_;
+  if (rep_ == other.rep_) {
+    return true;
+  }
+  if (rep_ == nullptr || other.rep_ == nullptr) {
+    // Exactly one of the TagMaps is empty.
+    return false;
+  }
+  if (rep_->id != 0 && other.rep_->id != 0) {
+    // Equal interned TagMaps share their representation.
+    return false;
+  }
+  return rep_->hash == other.rep_->hash && rep_->tags == other.rep_->tags;
 }
 
 std::string TagMap::DebugString() const {
   return absl::StrCat(
       "{",
       absl::StrJoin(
-          tags_, ", ",
+          tags(), ", ",
           [](std::string* o, std::pair<const TagKey&, const std::string&> kv) {
             absl::StrAppend(o, "\"", kv.first.name(), "\": \"", kv.second,
                             "\"");
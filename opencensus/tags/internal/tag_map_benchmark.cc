@@ -14,10 +14,12 @@
 
 #include "opencensus/tags/tag_map.h"
 
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "benchmark/benchmark.h"
 #include "opencensus/tags/tag_key.h"
 
@@ -41,6 +43,46 @@ void BM_MakeTagMap(benchmark::State& state) {
 }
 BENCHMARK(BM_MakeTagMap)->RangeMultiplier(2)->Range(1, 32);
 
+// Returns a vector with n tags, with the last tag value set to 'last_value'.
+std::vector<std::pair<TagKey, std::string>> MakeTags(
+    int n, absl::string_view last_value) {
+  std::vector<std::pair<TagKey, std::string>> tags;
+  tags.reserve(n);
+  for (int i = 0; i < n; ++i) {
+    tags.emplace_back(TagKey::Register(absl::StrCat("key", i)),
+                      i == n - 1 ? std::string(last_value)
+                                 : absl::StrCat("val", i));
+  }
+  return tags;
+}
+
+void BM_TagMapEqual(benchmark::State& state) {
+  const TagMap tm1(MakeTags(state.range(0), "value"));
+  const TagMap tm2(MakeTags(state.range(0), "value"));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tm1 == tm2);
+  }
+}
+BENCHMARK(BM_TagMapEqual)->RangeMultiplier(2)->Range(1, 32);
+
+void BM_TagMapEqualInterned(benchmark::State& state) {
+  const TagMap tm1 = TagMap(MakeTags(state.range(0), "value1")).Intern();
+  const TagMap tm2 = TagMap(MakeTags(state.range(0), "value2")).Intern();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tm1 == tm2);
+  }
+}
+BENCHMARK(BM_TagMapEqualInterned)->RangeMultiplier(2)->Range(1, 32);
+
+void BM_InternTagMap(benchmark::State& state) {
+  const TagMap interned = TagMap(MakeTags(state.range(0), "value")).Intern();
+  const TagMap tm(MakeTags(state.range(0), "value"));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tm.Intern());
+  }
+}
+BENCHMARK(BM_InternTagMap)->RangeMultiplier(2)->Range(1, 32);
+
 }  // namespace
 }  // namespace tags
 }  // namespace opencensus
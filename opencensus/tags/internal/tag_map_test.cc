@@ -104,6 +104,61 @@ TEST(TagMapTest, DebugStringContainsTags) {
   EXPECT_THAT(s, HasSubstr("value2"));
 }
 
+TEST(TagMapTest, MovedFromIsEmpty) {
+  TagKey key = TagKey::Register("key");
+  TagMap ts({{key, "value"}});
+  TagMap moved(std::move(ts));
+  EXPECT_EQ(TagMap({{key, "value"}}), moved);
+  EXPECT_TRUE(ts.tags().empty());
+  ts = std::move(moved);
+  EXPECT_EQ(TagMap({{key, "value"}}), ts);
+  EXPECT_TRUE(moved.tags().empty());
+}
+
+TEST(TagMapTest, Empty) {
+  TagKey key = TagKey::Register("key");
+  const TagMap empty({});
+  EXPECT_TRUE(empty.tags().empty());
+  EXPECT_EQ(empty, TagMap(std::vector<std::pair<TagKey, std::string>>()));
+  EXPECT_EQ(TagMap::Hash()(empty), TagMap::Hash()(TagMap({})));
+  EXPECT_NE(empty, TagMap({{key, ""}}));
+  EXPECT_NE(TagMap({{key, ""}}), empty);
+  EXPECT_EQ(0, empty.Intern().id());
+  EXPECT_EQ("{}", empty.DebugString());
+}
+
+TEST(TagMapTest, Intern) {
+  TagKey k1 = TagKey::Register("k1");
+  TagKey k2 = TagKey::Register("k2");
+  const TagMap ts({{k1, "v1"}, {k2, "v2"}});
+  EXPECT_EQ(0, ts.id());
+  const TagMap interned = ts.Intern();
+  EXPECT_NE(0, interned.id());
+  EXPECT_EQ(interned.id(), interned.Intern().id());
+  EXPECT_EQ(interned.id(), TagMap({{k2, "v2"}, {k1, "v1"}}).Intern().id());
+  EXPECT_NE(interned.id(), TagMap({{k1, "v2"}, {k2, "v1"}}).Intern().id());
+
+  EXPECT_EQ(ts, interned);
+  EXPECT_EQ(interned, ts);
+  EXPECT_EQ(TagMap::Hash()(ts), TagMap::Hash()(interned));
+  EXPECT_THAT(interned.tags(), ::testing::ElementsAreArray(ts.tags()));
+  EXPECT_NE(TagMap({{k1, "v2"}, {k2, "v1"}}).Intern(), interned);
+}
+
+TEST(TagMapTest, InternReclaimsUnusedTagMaps) {
+  TagKey key = TagKey::Register("key");
+  uint64_t id;
+  {
+    const TagMap interned = TagMap({{key, "reclaimed"}}).Intern();
+    id = interned.id();
+    EXPECT_EQ(id, TagMap({{key, "reclaimed"}}).Intern().id());
+  }
+  // The last copy was destroyed, so the tags are interned anew.
+  const TagMap interned = TagMap({{key, "reclaimed"}}).Intern();
+  EXPECT_NE(id, interned.id());
+  EXPECT_NE(0, interned.id());
+}
+
 TEST(TagMapDeathTest, DuplicateKeysNotAllowed) {
   TagKey k = TagKey::Register("k");
   EXPECT_DEBUG_DEATH(
@@ -16,7 +16,9 @@
 #define OPENCENSUS_TAGS_TAG_MAP_H_
 
 #include <cstddef>
+#include <cstdint>
 #include <initializer_list>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -28,8 +30,10 @@ namespace opencensus {
 namespace tags {
 
 // TagMap represents an immutable map of TagKeys to tag values (strings), and
-// provides efficient equality and hash operations. A TagMap is expensive to
-// construct, and should be shared between uses where possible.
+// provides efficient equality and hash operations. Constructing a non-empty
+// TagMap allocates, so it should be shared between uses where possible; copies
+// share the same underlying representation and never allocate, and empty
+// TagMaps (including default Context tags) take no allocation at all.
 class TagMap final {
  public:
   // Both constructors are not explicit so that Record({}, {{"k", "v"}}) works.
@@ -41,16 +45,35 @@ class TagMap final {
   // TagMaps. It takes the argument by value to allow it to be moved.
   TagMap(std::vector<std::pair<TagKey, std::string>> tags);
 
+  TagMap(const TagMap& other) = default;
+  TagMap& operator=(const TagMap& other) = default;
+  // Moved-from TagMaps are empty.
+  TagMap(TagMap&& other) = default;
+  TagMap& operator=(TagMap&& other) = default;
+
   // Accesses the tags sorted by key (in an implementation-defined, not
   // lexicographic, order).
   const std::vector<std::pair<TagKey, std::string>>& tags() const {
-    return tags_;
+    return rep_ != nullptr ? rep_->tags : EmptyTags();
   }
 
+  // Returns an equivalent TagMap from the global intern table, adding it if
+  // needed. Interned TagMaps with the same tags share a single representation
+  // and id, so comparing two of them takes constant time. An interned TagMap
+  // is removed from the table when its last copy is destroyed, so interning
+  // tagsets that go out of use does not leak.
+  TagMap Intern() const;
+
+  // Returns a nonzero id, unique over the lifetime of the process, if this is
+  // interned, and 0 otherwise. Empty TagMaps are never interned, since they
+  // already compare in constant time.
+  uint64_t id() const { return rep_ != nullptr ? rep_->id : 0; }
+
   struct Hash {
     std::size_t operator()(const TagMap& tags) const;
   };
 
+  // Takes constant time if both TagMaps are interned or copies of each other.
   bool operator==(const TagMap& other) const;
   bool operator!=(const TagMap& other) const { return !(*this == other); }
 
@@ -59,11 +82,27 @@ class TagMap final {
   std::string DebugString() const;
 
  private:
-  void Initialize();
+  friend class TagMapInternTable;
+
+  struct Rep {
+    std::size_t hash;
+    // The intern id, or 0 if not interned.
+    uint64_t id;
+    // TODO: add an option to store string_views to avoid copies.
+    std::vector<std::pair<TagKey, std::string>> tags;
+  };
+
+  explicit TagMap(std::shared_ptr<const Rep> rep) : rep_(std::move(rep)) {}
+
+  static const std::vector<std::pair<TagKey, std::string>>& EmptyTags();
+
+  // Sorts and validates 'tags', and returns a representation of them, or null
+  // if they are empty.
+  static std::shared_ptr<const Rep> MakeRep(
+      std::vector<std::pair<TagKey, std::string>> tags);
 
-  std::size_t hash_;
-  // TODO: add an option to store string_views to avoid copies.
-  std::vector<std::pair<TagKey, std::string>> tags_;
+  // Null if the TagMap is empty.
+  std::shared_ptr<const Rep> rep_;
 };
 
 }  // namespace tags